@@ -4,6 +4,9 @@ extern "C" void kernel_main(uint32_t magic, void* mbi) {
     // do the assigned functions
     feron::kmain(magic, mbi);
 
-    // halt
-    for (;;) asm volatile("hlt");
+    // idle: prepare zeroed pages while there is nothing else to do, then halt
+    for (;;) {
+        feron::mm::zeropool::refill();
+        asm volatile("hlt");
+    }
 }
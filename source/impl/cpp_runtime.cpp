@@ -3,16 +3,19 @@
 
 #include <cstddef>
 #include <cstdint>
+#include "../inc/runtime/impl/mem/cpy.hpp"
+#include "../inc/runtime/impl/mem/set.hpp"
+#include "../inc/runtime/impl/mm/kernel_heap_backend.hpp"
+#include "../inc/cpu/context.hpp"
+#include "../inc/sync/spinlock.hpp"
 
 // stubbed std helpers used by new/delete signatures
 namespace std {
     struct nothrow_t {};
     inline constexpr nothrow_t nothrow{};
 
-    struct align_val_t {
-        explicit align_val_t(std::size_t a) : value(a) {}
-        std::size_t value;
-    };
+    // must match the compiler's own declaration, or aligned new-expressions never reach us
+    enum class align_val_t : std::size_t {};
 }
 
 extern "C" {
@@ -20,39 +23,31 @@ extern "C" {
 // -----------------------------
 // Kernel heap management state
 // -----------------------------
-static unsigned char* heap_start = nullptr;
-static unsigned char* heap_end   = nullptr;
-
+// The boundary-tag heap is a list of chunks. The first one is the bootstrap region handed
+// to kernel_heap_init; once mm registers a backend, the heap grows by mapping further
+// chunks and gives fully free ones back above a high-water mark of free bytes.
 static struct HeapConfig {
     bool initialized = false;
-    std::size_t total_size = 0;
+    std::size_t total_size = 0;         // bytes in all chunks
+    std::size_t free_bytes = 0;         // bytes in free blocks
 } heap_config;
 
-// call this once with your memory region
-void kernel_heap_init(void* addr, std::size_t size) {
-    if (!addr || size < 64) return; // sanity
-    heap_start = reinterpret_cast<unsigned char*>(addr);
-    heap_end   = heap_start + size;
-    heap_config.initialized = true;
-    heap_config.total_size = size;
-}
+static const kernel_heap_backend_t* heap_backend = nullptr;
 
 // -----------------------------
 // Low-level helpers
 // -----------------------------
-static inline std::size_t align_up(std::size_t n, std::size_t a) {
+static constexpr std::size_t align_up(std::size_t n, std::size_t a) {
     return (n + (a - 1)) & ~(a - 1);
 }
-
-// spinlock for simple thread-safety (single-core safe for now)
-static volatile uint8_t allocator_lock_flag = 0;
-static inline void spin_lock() {
-    while (__atomic_test_and_set(&allocator_lock_flag, __ATOMIC_ACQUIRE)) {}
-}
-static inline void spin_unlock() {
-    __atomic_clear(&allocator_lock_flag, __ATOMIC_RELEASE);
+static inline bool is_power_of_two(std::size_t n) {
+    return n && !(n & (n - 1));
 }
 
+// Guards chunks, the free list and the slabs. Always taken with interrupts masked, so a
+// handler that allocates can never spin on a lock its own CPU holds.
+static feron::sync::ticket_lock_t heap_lock;
+
 // -----------------------------
 // Block layout and freelist
 // -----------------------------
@@ -62,14 +57,14 @@ struct BlockHeader {
     BlockHeader* prev_free;
 };
 
-// We'll compute an aligned header size at allocator init and use it consistently.
-static std::size_t header_size_aligned = 0;
+// Payload offset from the header; constant, so even the first allocation gets it right
+static constexpr std::size_t header_size_aligned = align_up(sizeof(BlockHeader), alignof(std::max_align_t));
 
 static inline std::size_t footer_size() { return sizeof(std::size_t); }
 static inline std::size_t min_payload() { return 16; }
 static inline std::size_t min_block_size() {
-    // header + footer + min payload
-    return header_size_aligned + footer_size() + min_payload();
+    // header + footer + min payload, rounded so every block keeps payloads aligned
+    return align_up(header_size_aligned + footer_size() + min_payload(), alignof(std::max_align_t));
 }
 
 static BlockHeader* free_list_head = nullptr;
@@ -89,20 +84,17 @@ static inline void write_footer(BlockHeader* h) {
     unsigned char* footer_pos = reinterpret_cast<unsigned char*>(h) + sz - sizeof(std::size_t);
     *reinterpret_cast<std::size_t*>(footer_pos) = sz;
 }
+// Chunks end in a zero-sized allocated header (epilogue) and start behind a zero footer
+// (prologue), so neighbour lookups stop at chunk edges without knowing the chunk
 static inline BlockHeader* next_phys(BlockHeader* h) {
-    unsigned char* next = reinterpret_cast<unsigned char*>(h) + block_size(h);
-    if (next >= heap_end) return nullptr;
-    return reinterpret_cast<BlockHeader*>(next);
+    BlockHeader* next = reinterpret_cast<BlockHeader*>(reinterpret_cast<unsigned char*>(h) + block_size(h));
+    return block_size(next) ? next : nullptr;
 }
 static inline BlockHeader* prev_phys(BlockHeader* h) {
     unsigned char* hdr_ptr = reinterpret_cast<unsigned char*>(h);
-    if (hdr_ptr == heap_start) return nullptr;
-    unsigned char* prev_footer_pos = hdr_ptr - sizeof(std::size_t);
-    std::size_t prev_size = *reinterpret_cast<std::size_t*>(prev_footer_pos);
+    std::size_t prev_size = *reinterpret_cast<std::size_t*>(hdr_ptr - sizeof(std::size_t));
     if (prev_size == 0) return nullptr;
-    unsigned char* prev_hdr_pos = hdr_ptr - prev_size;
-    if (prev_hdr_pos < heap_start) return nullptr;
-    return reinterpret_cast<BlockHeader*>(prev_hdr_pos);
+    return reinterpret_cast<BlockHeader*>(hdr_ptr - prev_size);
 }
 
 // freelist helpers
@@ -120,78 +112,174 @@ static inline void insert_into_freelist(BlockHeader* b) {
     free_list_head = b;
 }
 
-// allocator initialization
-static inline void allocator_init() {
-    if (!heap_config.initialized) return;
-    if (header_size_aligned == 0) {
-        header_size_aligned = align_up(sizeof(BlockHeader), alignof(std::max_align_t));
+// -----------------------------
+// Heap chunks
+// -----------------------------
+struct HeapChunk {
+    uint32_t magic;
+    uint32_t boot;              // the bootstrap region; never given back
+    std::size_t size;           // whole chunk, header and epilogue included
+    HeapChunk* next;
+    HeapChunk* prev;
+};
+
+static constexpr uint32_t CHUNK_MAGIC = 0xC4C4C4C4u;
+static constexpr uint32_t HUGE_MAGIC = 0x46E646E6u;
+static constexpr std::size_t HEAP_PAGE = 4096;
+// chunk header plus the prologue footer, rounded so the first block is aligned
+static constexpr std::size_t CHUNK_HEADER = align_up(sizeof(HeapChunk) + sizeof(std::size_t), alignof(std::max_align_t));
+static constexpr std::size_t CHUNK_EPILOGUE = alignof(std::max_align_t);
+
+static HeapChunk* chunk_list = nullptr;
+static unsigned char* boot_chunk_start = nullptr;
+static unsigned char* boot_chunk_end = nullptr;
+
+static inline BlockHeader* chunk_first_block(HeapChunk* c) {
+    return reinterpret_cast<BlockHeader*>(reinterpret_cast<unsigned char*>(c) + CHUNK_HEADER);
+}
+static inline std::size_t chunk_usable(const HeapChunk* c) {
+    return c->size - CHUNK_HEADER - CHUNK_EPILOGUE;
+}
+
+// Lay out [addr, addr + size) as a chunk holding one free block (caller holds the lock)
+static HeapChunk* chunk_add(void* addr, std::size_t size, bool boot) {
+    unsigned char* base = reinterpret_cast<unsigned char*>(align_up(reinterpret_cast<std::size_t>(addr), alignof(std::max_align_t)));
+    size -= static_cast<std::size_t>(base - reinterpret_cast<unsigned char*>(addr));
+    size &= ~(alignof(std::max_align_t) - 1);
+    if (size < CHUNK_HEADER + CHUNK_EPILOGUE + min_block_size()) return nullptr;
+
+    HeapChunk* c = reinterpret_cast<HeapChunk*>(base);
+    c->magic = CHUNK_MAGIC;
+    c->boot = boot;
+    c->size = size;
+    c->prev = nullptr;
+    c->next = chunk_list;
+    if (chunk_list) chunk_list->prev = c;
+    chunk_list = c;
+
+    *reinterpret_cast<std::size_t*>(base + CHUNK_HEADER - sizeof(std::size_t)) = 0;   // prologue
+    reinterpret_cast<BlockHeader*>(base + size - CHUNK_EPILOGUE)->size_and_flag = 1;     // epilogue
+
+    BlockHeader* b = chunk_first_block(c);
+    b->size_and_flag = chunk_usable(c);
+    write_footer(b);
+    insert_into_freelist(b);
+
+    heap_config.total_size += chunk_usable(c);
+    heap_config.free_bytes += chunk_usable(c);
+    return c;
+}
+
+// Map a fresh chunk big enough for a block of total bytes (caller holds the lock)
+static bool chunk_grow(std::size_t total) {
+    if (!heap_backend) return false;
+    std::size_t bytes = align_up(total + CHUNK_HEADER + CHUNK_EPILOGUE, HEAP_PAGE);
+    if (bytes < heap_backend->chunk_size) bytes = heap_backend->chunk_size;
+    void* mem = heap_backend->map_alloc(bytes / HEAP_PAGE);
+    if (!mem) return false;
+    return chunk_add(mem, bytes, false) != nullptr;
+}
+
+// Give c back when it is entirely free and the heap holds more free memory than the
+// backend's high-water mark (caller holds the lock)
+static void chunk_maybe_release(BlockHeader* b) {
+    if (!heap_backend || prev_phys(b) || next_phys(b)) return;
+    HeapChunk* c = reinterpret_cast<HeapChunk*>(reinterpret_cast<unsigned char*>(b) - CHUNK_HEADER);
+    if (c->magic != CHUNK_MAGIC || c->boot) return;
+    if (heap_config.free_bytes - chunk_usable(c) < heap_backend->free_high_water) return;
+
+    remove_from_freelist(b);
+    if (c->prev) c->prev->next = c->next;
+    else chunk_list = c->next;
+    if (c->next) c->next->prev = c->prev;
+    heap_config.total_size -= chunk_usable(c);
+    heap_config.free_bytes -= chunk_usable(c);
+    c->magic = 0;
+    heap_backend->map_free(c, c->size / HEAP_PAGE);
+}
+
+// call this once with your memory region
+void kernel_heap_init(void* addr, std::size_t size) {
+    if (!addr || size < 64) return; // sanity
+    feron::sync::irq_lock_guard g(heap_lock);
+    if (!heap_config.initialized && chunk_add(addr, size, true)) {
+        boot_chunk_start = reinterpret_cast<unsigned char*>(addr);
+        boot_chunk_end = boot_chunk_start + size;
+        heap_config.initialized = true;
     }
-    if (free_list_head != nullptr) return;
-    BlockHeader* initial = reinterpret_cast<BlockHeader*>(heap_start);
-    initial->size_and_flag = (heap_end - heap_start) & ~static_cast<std::size_t>(1u); // free
-    initial->next_free = nullptr;
-    initial->prev_free = nullptr;
-    write_footer(initial);
-    free_list_head = initial;
 }
 
 // -----------------------------
 // Allocation / Free implementation
 // -----------------------------
-static void* allocator_alloc(std::size_t payload_size, std::size_t /*alignment*/) {
-    if (!heap_config.initialized) return nullptr;
-    if (payload_size == 0) payload_size = 1;
-
-    // Use a fixed payload offset equal to the aligned header size.
-    // This keeps header <-> payload arithmetic simple and consistent for free().
-    std::size_t payload_offset = header_size_aligned;
-    std::size_t total_needed = payload_offset + payload_size + footer_size();
-    total_needed = align_up(total_needed, alignof(std::max_align_t));
-    if (total_needed < min_block_size()) total_needed = min_block_size();
-
-    spin_lock();
-    allocator_init();
-    BlockHeader* cur = free_list_head;
-    while (cur) {
-        std::size_t cur_sz = block_size(cur);
-        if (cur_sz >= total_needed) {
-            std::size_t remaining = cur_sz - total_needed;
-            if (remaining >= min_block_size()) {
-                // split block: cur becomes allocated block of size total_needed
-                unsigned char* next_pos = reinterpret_cast<unsigned char*>(cur) + total_needed;
-                BlockHeader* new_free = reinterpret_cast<BlockHeader*>(next_pos);
-                new_free->size_and_flag = remaining & ~static_cast<std::size_t>(1u);
-                write_footer(new_free);
-
-                // replace cur in free list with new_free
-                new_free->next_free = cur->next_free;
-                if (new_free->next_free) new_free->next_free->prev_free = new_free;
-                new_free->prev_free = cur->prev_free;
-                if (new_free->prev_free) new_free->prev_free->next_free = new_free;
-                else free_list_head = new_free;
-
-                // shrink cur
-                cur->size_and_flag = total_needed & ~static_cast<std::size_t>(1u);
-                write_footer(cur);
-            } else {
-                // use entire block
-                remove_from_freelist(cur);
-            }
-            set_allocated(cur, true);
+// First fit over the free list for a block of total bytes whose payload is aligned to
+// alignment. Slack in front of the payload is split off as a free block of its own rather
+// than wasted. nullptr when no block fits (caller holds the lock).
+static void* allocator_take(std::size_t total_needed, std::size_t alignment) {
+    for (BlockHeader* cur = free_list_head; cur; cur = cur->next_free) {
+        std::size_t start = reinterpret_cast<std::size_t>(cur);
+        std::size_t payload = align_up(start + header_size_aligned, alignment);
+        std::size_t lead = payload - header_size_aligned - start;
+        // slack too small to stand as a free block: use the next aligned slot
+        while (lead && lead < min_block_size()) {
+            payload += alignment;
+            lead += alignment;
+        }
+        if (lead + total_needed > block_size(cur)) continue;
+
+        BlockHeader* b = cur;
+        if (lead) {
+            // cur keeps the slack and stays on the free list
+            b = reinterpret_cast<BlockHeader*>(start + lead);
+            b->size_and_flag = block_size(cur) - lead;
+            cur->size_and_flag = lead;
             write_footer(cur);
-            spin_unlock();
-            unsigned char* user_ptr = reinterpret_cast<unsigned char*>(cur) + payload_offset;
-            return static_cast<void*>(user_ptr);
+        } else {
+            remove_from_freelist(cur);
+        }
+
+        std::size_t remaining = block_size(b) - total_needed;
+        if (remaining >= min_block_size()) {
+            // split the tail off as a new free block
+            BlockHeader* tail = reinterpret_cast<BlockHeader*>(reinterpret_cast<unsigned char*>(b) + total_needed);
+            tail->size_and_flag = remaining;
+            write_footer(tail);
+            insert_into_freelist(tail);
+            b->size_and_flag = total_needed;
         }
-        cur = cur->next_free;
+        set_allocated(b, true);
+        write_footer(b);
+        heap_config.free_bytes -= block_size(b);
+        return reinterpret_cast<void*>(payload);
     }
-    spin_unlock();
-    return nullptr; // out of memory
+    return nullptr;
+}
+
+// Block size for a payload. The payload always sits header_size_aligned past its header,
+// so free() finds the header without knowing how the block was aligned.
+static inline std::size_t block_total(std::size_t payload_size) {
+    std::size_t total = align_up(header_size_aligned + payload_size + footer_size(), alignof(std::max_align_t));
+    return total < min_block_size() ? min_block_size() : total;
+}
+
+static void* allocator_alloc(std::size_t payload_size, std::size_t alignment) {
+    if (payload_size == 0) payload_size = 1;
+    if (alignment < alignof(std::max_align_t)) alignment = alignof(std::max_align_t);
+
+    std::size_t total_needed = block_total(payload_size);
+    // worst case slack in front of an aligned payload
+    std::size_t slack = alignment > alignof(std::max_align_t) ? alignment + min_block_size() : 0;
+
+    feron::sync::irq_lock_guard g(heap_lock);
+    void* p = allocator_take(total_needed, alignment);
+    if (!p && chunk_grow(total_needed + slack)) p = allocator_take(total_needed, alignment);
+    return p; // nullptr: out of memory
 }
 
 static void allocator_coalesce_and_free(BlockHeader* h) {
     set_allocated(h, false);
     write_footer(h);
+    heap_config.free_bytes += block_size(h);
 
     BlockHeader* nx = next_phys(h);
     if (nx && !is_allocated(nx)) {
@@ -208,57 +296,461 @@ static void allocator_coalesce_and_free(BlockHeader* h) {
         pv->size_and_flag = newsize & ~static_cast<std::size_t>(1u);
         write_footer(pv);
         insert_into_freelist(pv);
+        h = pv;
     } else {
         insert_into_freelist(h);
     }
+    chunk_maybe_release(h);
 }
 
 static void allocator_free(void* ptr) {
     if (!ptr) return;
     if (!heap_config.initialized) return;
 
-    unsigned char* u = reinterpret_cast<unsigned char*>(ptr);
-    if (u < heap_start + header_size_aligned) return; // too small to be valid
-    unsigned char* hdr_candidate = u - header_size_aligned;
-    if (hdr_candidate < heap_start) return;
-
+    unsigned char* hdr_candidate = reinterpret_cast<unsigned char*>(ptr) - header_size_aligned;
     BlockHeader* h = reinterpret_cast<BlockHeader*>(hdr_candidate);
-    // basic sanity: block size must be reasonable
+    // basic sanity: must be a live block of a plausible size
     std::size_t sz = block_size(h);
-    if (sz == 0 || hdr_candidate + sz > heap_end) return;
+    if (sz < min_block_size() || !is_allocated(h)) return;
 
-    spin_lock();
+    feron::sync::irq_lock_guard g(heap_lock);
     allocator_coalesce_and_free(h);
-    spin_unlock();
+}
+
+// Resize the block behind ptr without moving it: grow by absorbing the following free
+// block, then split anything beyond the new size off as a free block. false when the
+// neighbour is taken or too small.
+static bool allocator_resize(void* ptr, std::size_t payload_size) {
+    BlockHeader* h = reinterpret_cast<BlockHeader*>(reinterpret_cast<unsigned char*>(ptr) - header_size_aligned);
+    std::size_t total_needed = block_total(payload_size);
+
+    feron::sync::irq_lock_guard g(heap_lock);
+    std::size_t cur = block_size(h);
+    if (total_needed > cur) {
+        BlockHeader* nx = next_phys(h);
+        if (!nx || is_allocated(nx) || cur + block_size(nx) < total_needed) return false;
+        remove_from_freelist(nx);
+        heap_config.free_bytes -= block_size(nx);
+        h->size_and_flag = cur + block_size(nx);
+        set_allocated(h, true);
+        write_footer(h);
+    }
+
+    std::size_t remaining = block_size(h) - total_needed;
+    if (remaining >= min_block_size()) {
+        BlockHeader* tail = reinterpret_cast<BlockHeader*>(reinterpret_cast<unsigned char*>(h) + total_needed);
+        tail->size_and_flag = remaining;
+        h->size_and_flag = total_needed;
+        set_allocated(h, true);
+        write_footer(h);
+        allocator_coalesce_and_free(tail);   // merges with a free block behind it
+    }
+    return true;
+}
+
+// -----------------------------
+// Huge allocations
+// -----------------------------
+// Requests of at least the backend's huge threshold get a mapping of their own, so they
+// neither fragment the chunks nor pin a whole chunk; free unmaps them right away.
+// The mapping is page aligned, so any alignment up to a page only moves the payload.
+struct HugeHeader {
+    uint32_t magic;
+    uint32_t offset;            // payload offset from the header
+    std::size_t pages;
+};
+
+static constexpr std::size_t HUGE_HEADER = align_up(sizeof(HugeHeader), alignof(std::max_align_t));
+
+// zeroed: take pre-zeroed frames, so the payload needs no clearing
+static void* huge_alloc(std::size_t size, std::size_t alignment, bool zeroed = false) {
+    std::size_t offset = alignment > HUGE_HEADER ? alignment : HUGE_HEADER;
+    std::size_t pages = align_up(size + offset, HEAP_PAGE) / HEAP_PAGE;
+    void* mem = zeroed ? heap_backend->map_alloc_zeroed(pages) : heap_backend->map_alloc(pages);
+    if (!mem) return nullptr;
+    HugeHeader* h = reinterpret_cast<HugeHeader*>(mem);
+    h->magic = HUGE_MAGIC;
+    h->offset = static_cast<uint32_t>(offset);
+    h->pages = pages;
+    return reinterpret_cast<unsigned char*>(mem) + offset;
+}
+
+static void huge_free(HugeHeader* h) {
+    h->magic = 0;
+    heap_backend->map_free(h, h->pages);
+}
+
+// Shrink in place by unmapping the tail pages; a mapping cannot grow in place
+static bool huge_resize(HugeHeader* h, std::size_t size) {
+    std::size_t pages = align_up(size + h->offset, HEAP_PAGE) / HEAP_PAGE;
+    if (pages > h->pages) return false;
+    if (size < heap_backend->huge_threshold) return false;      // small enough for the chunks again
+    if (pages < h->pages) {
+        heap_backend->map_free(reinterpret_cast<unsigned char*>(h) + pages * HEAP_PAGE, h->pages - pages);
+        h->pages = pages;
+    }
+    return true;
+}
+
+// -----------------------------
+// Slab layer for small objects
+// -----------------------------
+// Requests up to SLAB_MAX bytes are served from per-size-class slabs: runs of backend
+// pages holding equal-sized objects, linked through an in-slab freelist, with a bitmap
+// that catches double frees. Classes step by at most 1.25x (four per power of two), so
+// rounding wastes little. The backend tags slab pages with their base, which is where
+// the SlabHeader lives, so free() finds the slab in O(1). Objects start on a cache line,
+// so any class whose size is a multiple of an alignment up to 64 serves that alignment.
+static constexpr std::size_t SLAB_PAGE = 4096;
+static constexpr std::size_t SLAB_MAX = 2048;
+static constexpr std::size_t SLAB_GRAIN = 16;                   // minimum object alignment and class granularity
+static constexpr std::size_t SLAB_ALIGN = 64;                   // alignment of the first object
+static constexpr std::size_t SLAB_MAX_OBJECTS = 256;            // bitmap capacity
+static constexpr std::size_t SLAB_MAX_PAGES = 8;
+static constexpr uint32_t SLAB_MAGIC = 0x51AB51ABu;
+
+struct SlabHeader {
+    uint32_t magic;
+    uint16_t cls;
+    uint16_t pages;
+    uint16_t inuse;
+    uint16_t total;
+    void* free_head;                     // next free object; each free object stores the next one
+    unsigned char* objects;
+    SlabHeader* next;                    // class partial list
+    SlabHeader* prev;
+    uint64_t used[SLAB_MAX_OBJECTS / 64];   // bit set = held by a caller; changed with atomics only
+};
+
+struct SlabClass {
+    std::size_t size = 0;
+    uint16_t pages = 0;
+    uint16_t per_slab = 0;
+    SlabHeader* partial = nullptr;       // slabs with free objects and at least one in use
+    SlabHeader* empty = nullptr;         // one fully free slab kept back to absorb churn
+};
+
+static constexpr std::size_t SLAB_CLASS_COUNT = 24;             // 16..2048
+static SlabClass slab_classes[SLAB_CLASS_COUNT];
+static uint8_t slab_class_for[SLAB_MAX / SLAB_GRAIN + 1];       // (size + 15) / 16 -> class
+
+static inline std::size_t slab_objects_offset() { return align_up(sizeof(SlabHeader), SLAB_ALIGN); }
+
+static void slab_init_classes() {
+    // 16, 32, 48, 64, then four steps per power of two: 80, 96, 112, 128, 160, ... 2048
+    std::size_t n = 0;
+    for (std::size_t s = SLAB_GRAIN; s <= 64; s += SLAB_GRAIN) slab_classes[n++].size = s;
+    for (std::size_t p = 64; p < SLAB_MAX; p *= 2) {
+        for (std::size_t q = 1; q <= 4; ++q) slab_classes[n++].size = p + q * (p / 4);
+    }
+
+    std::size_t c = 0;
+    for (std::size_t g = 0; g <= SLAB_MAX / SLAB_GRAIN; ++g) {
+        while (slab_classes[c].size < g * SLAB_GRAIN) ++c;
+        slab_class_for[g] = static_cast<uint8_t>(c);
+    }
+
+    // smallest slab (in pages) that holds at least eight objects
+    for (auto& cls : slab_classes) {
+        std::size_t pages = 1;
+        while (pages < SLAB_MAX_PAGES && (pages * SLAB_PAGE - slab_objects_offset()) / cls.size < 8) pages *= 2;
+        std::size_t per = (pages * SLAB_PAGE - slab_objects_offset()) / cls.size;
+        cls.pages = static_cast<uint16_t>(pages);
+        cls.per_slab = static_cast<uint16_t>(per < SLAB_MAX_OBJECTS ? per : SLAB_MAX_OBJECTS);
+        cls.partial = cls.empty = nullptr;
+    }
+}
+
+void kernel_heap_set_backend(const kernel_heap_backend_t* backend) {
+    feron::sync::irq_lock_guard g(heap_lock);
+    if (!heap_backend) slab_init_classes();
+    heap_backend = backend;
+}
+
+static inline void slab_list_push(SlabClass& c, SlabHeader* s) {
+    s->prev = nullptr;
+    s->next = c.partial;
+    if (c.partial) c.partial->prev = s;
+    c.partial = s;
+}
+
+static inline void slab_list_remove(SlabClass& c, SlabHeader* s) {
+    if (s->prev) s->prev->next = s->next;
+    else c.partial = s->next;
+    if (s->next) s->next->prev = s->prev;
+    s->next = s->prev = nullptr;
+}
+
+static SlabHeader* slab_create(uint16_t cls) {
+    SlabClass& c = slab_classes[cls];
+    void* base = heap_backend->page_alloc(c.pages);
+    if (!base) return nullptr;
+
+    SlabHeader* s = reinterpret_cast<SlabHeader*>(base);
+    s->magic = SLAB_MAGIC;
+    s->cls = cls;
+    s->pages = c.pages;
+    s->inuse = 0;
+    s->total = c.per_slab;
+    s->objects = reinterpret_cast<unsigned char*>(base) + slab_objects_offset();
+    s->next = s->prev = nullptr;
+    for (auto& w : s->used) w = 0;
+
+    // thread the freelist front to back so objects go out in address order
+    void* head = nullptr;
+    for (std::size_t i = s->total; i-- > 0;) {
+        void* obj = s->objects + i * c.size;
+        *reinterpret_cast<void**>(obj) = head;
+        head = obj;
+    }
+    s->free_head = head;
+    return s;
+}
+
+// Smallest class holding size bytes whose objects all land on alignment, or SLAB_CLASS_COUNT
+static inline std::size_t slab_class_aligned(std::size_t size, std::size_t alignment) {
+    std::size_t cls = slab_class_for[(size + SLAB_GRAIN - 1) / SLAB_GRAIN];
+    if (alignment <= SLAB_GRAIN) return cls;
+    if (alignment > SLAB_ALIGN) return SLAB_CLASS_COUNT;
+    while (cls < SLAB_CLASS_COUNT && slab_classes[cls].size % alignment) ++cls;
+    return cls;
+}
+
+// caller holds the heap lock
+static void* slab_alloc(uint16_t cls) {
+    SlabClass& c = slab_classes[cls];
+
+    SlabHeader* s = c.partial;
+    if (!s) {
+        if (c.empty) { s = c.empty; c.empty = nullptr; }
+        else if (!(s = slab_create(cls))) return nullptr;
+        slab_list_push(c, s);
+    }
+
+    // the object goes to an object cache; its used bit is set when a caller takes it
+    void* obj = s->free_head;
+    s->free_head = *reinterpret_cast<void**>(obj);
+    if (++s->inuse == s->total) slab_list_remove(c, s);   // full slabs leave the list
+    return obj;
+}
+
+// Index of ptr within s; false when ptr is not the start of one of its objects
+static bool slab_object_index(const SlabHeader* s, const void* ptr, std::size_t& idx) {
+    std::size_t size = slab_classes[s->cls].size;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(ptr);
+    if (p < s->objects) return false;
+    std::size_t off = static_cast<std::size_t>(p - s->objects);
+    idx = off / size;
+    return off % size == 0 && idx < s->total;
+}
+
+// Mark an object held (true) or not (false) with a locked bts/btr on its bitmap word.
+// Returns the previous state.
+static inline bool slab_mark(SlabHeader* s, std::size_t idx, bool held) {
+    uint64_t bit = 1ull << (idx % 64);
+    uint64_t old = held ? __atomic_fetch_or(&s->used[idx / 64], bit, __ATOMIC_ACQ_REL)
+                        : __atomic_fetch_and(&s->used[idx / 64], ~bit, __ATOMIC_ACQ_REL);
+    return (old & bit) != 0;
+}
+
+// Put a cached object back on its slab's freelist (caller holds the heap lock)
+static void slab_free(SlabHeader* s, void* ptr) {
+    SlabClass& c = slab_classes[s->cls];
+    *reinterpret_cast<void**>(ptr) = s->free_head;
+    s->free_head = ptr;
+
+    if (s->inuse-- == s->total) slab_list_push(c, s);      // was full
+    if (s->inuse == 0) {
+        slab_list_remove(c, s);
+        if (!c.empty) c.empty = s;
+        else heap_backend->page_free(s, s->pages);
+    }
+}
+
+// -----------------------------
+// Per-CPU object caches
+// -----------------------------
+// Each (cpu, level) pair keeps a small LIFO stack of free objects per slab class, so most
+// small allocations and frees take no lock and no cli: the only shared write is one locked
+// bit flip on the object's slab bitmap. An interrupt handler works on its own stacks, so
+// it never races the code it interrupted. The heap lock is only taken to refill or drain
+// OBJECT_CACHE_BATCH objects. An object's used bit is set while a caller holds it and
+// clear while it sits in any cache, so a second free is refused no matter which CPU or
+// level it comes from.
+static constexpr uint32_t OBJECT_CACHE_SIZE = 16;
+static constexpr uint32_t OBJECT_CACHE_BATCH = 8;
+
+struct alignas(64) ObjectCache {
+    uint32_t count;
+    void* objects[OBJECT_CACHE_SIZE];    // objects[count - 1] is the most recently freed
+};
+
+static ObjectCache object_caches[feron::cpu::context::MAX_CPUS][feron::cpu::context::LEVEL_COUNT][SLAB_CLASS_COUNT];
+
+static inline ObjectCache& local_object_cache(uint16_t cls) {
+    return object_caches[feron::cpu::context::id()][feron::cpu::context::level()][cls];
+}
+
+static void* object_cache_alloc(uint16_t cls) {
+    ObjectCache& oc = local_object_cache(cls);
+    if (!oc.count) {
+        feron::sync::irq_lock_guard g(heap_lock);
+        while (oc.count < OBJECT_CACHE_BATCH) {
+            void* p = slab_alloc(cls);
+            if (!p) break;
+            oc.objects[oc.count++] = p;
+        }
+        if (!oc.count) return nullptr;
+    }
+    void* obj = oc.objects[--oc.count];
+    SlabHeader* s = reinterpret_cast<SlabHeader*>(heap_backend->page_owner(obj));
+    slab_mark(s, static_cast<std::size_t>(reinterpret_cast<unsigned char*>(obj) - s->objects) / slab_classes[cls].size, true);
+    return obj;
+}
+
+// A full cache hands its OBJECT_CACHE_BATCH oldest objects back to their slabs
+static void object_cache_free(SlabHeader* s, void* ptr) {
+    std::size_t idx;
+    if (!slab_object_index(s, ptr, idx)) return;           // stray pointer
+    if (!slab_mark(s, idx, false)) return;                 // double free
+    ObjectCache& oc = local_object_cache(s->cls);
+
+    if (oc.count == OBJECT_CACHE_SIZE) {
+        {
+            feron::sync::irq_lock_guard g(heap_lock);
+            for (uint32_t i = 0; i < OBJECT_CACHE_BATCH; ++i) {
+                slab_free(reinterpret_cast<SlabHeader*>(heap_backend->page_owner(oc.objects[i])), oc.objects[i]);
+            }
+        }
+        for (uint32_t i = OBJECT_CACHE_BATCH; i < OBJECT_CACHE_SIZE; ++i) oc.objects[i - OBJECT_CACHE_BATCH] = oc.objects[i];
+        oc.count -= OBJECT_CACHE_BATCH;
+    }
+    oc.objects[oc.count++] = ptr;
+}
+
+// -----------------------------
+// Front end: route each pointer to the layer that owns it
+// -----------------------------
+enum class HeapKind { none, slab, huge, block };
+
+// Backend pages are tagged with the base of their slab, chunk or huge mapping, whose
+// header says which layer owns them; untagged pointers can only be in the boot chunk
+static HeapKind heap_kind(const void* ptr, void*& base) {
+    base = heap_backend ? heap_backend->page_owner(ptr) : nullptr;
+    if (base) {
+        uint32_t magic = *reinterpret_cast<const uint32_t*>(base);
+        if (magic == SLAB_MAGIC) return HeapKind::slab;
+        if (magic == HUGE_MAGIC) return HeapKind::huge;
+        if (magic == CHUNK_MAGIC) return HeapKind::block;
+        return HeapKind::none;
+    }
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(ptr);
+    return (p >= boot_chunk_start && p < boot_chunk_end) ? HeapKind::block : HeapKind::none;
+}
+
+// Usable bytes behind ptr
+static std::size_t allocation_size(void* ptr) {
+    void* base;
+    switch (heap_kind(ptr, base)) {
+        case HeapKind::slab:
+            return slab_classes[reinterpret_cast<SlabHeader*>(base)->cls].size;
+        case HeapKind::huge:
+            return reinterpret_cast<HugeHeader*>(base)->pages * HEAP_PAGE - reinterpret_cast<HugeHeader*>(base)->offset;
+        case HeapKind::block: {
+            BlockHeader* h = reinterpret_cast<BlockHeader*>(reinterpret_cast<unsigned char*>(ptr) - header_size_aligned);
+            return block_size(h) - header_size_aligned - footer_size();
+        }
+        default:
+            return 0;
+    }
+}
+
+// alignment is a power of two
+static void* heap_alloc(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) {
+    if (size == 0) size = 1;
+    if (size <= SLAB_MAX && heap_backend) {
+        std::size_t cls = slab_class_aligned(size, alignment);
+        void* p = cls < SLAB_CLASS_COUNT ? object_cache_alloc(static_cast<uint16_t>(cls)) : nullptr;
+        if (p) return p;
+    }
+    if (heap_backend && size >= heap_backend->huge_threshold && alignment <= HEAP_PAGE) return huge_alloc(size, alignment);
+    // everything else, and small requests before the backend exists or when it is out of pages
+    return allocator_alloc(size, alignment);
+}
+
+// Fit ptr's allocation to size without moving it; false when it has to move
+static bool heap_resize(void* ptr, std::size_t size) {
+    void* base;
+    switch (heap_kind(ptr, base)) {
+        case HeapKind::slab: {
+            // stay while the class fits and is not more than twice what is needed
+            std::size_t cls = slab_classes[reinterpret_cast<SlabHeader*>(base)->cls].size;
+            return size <= cls && (cls <= 64 || size > cls / 2);
+        }
+        case HeapKind::huge:
+            return huge_resize(reinterpret_cast<HugeHeader*>(base), size);
+        case HeapKind::block:
+            // growing a small block into the chunks is fine; huge sizes belong in their own mapping
+            if (heap_backend && size >= heap_backend->huge_threshold && size > allocation_size(ptr)) return false;
+            return allocator_resize(ptr, size);
+        default:
+            return false;
+    }
+}
+
+static void heap_free(void* ptr) {
+    if (!ptr) return;
+    void* base;
+    switch (heap_kind(ptr, base)) {
+        case HeapKind::slab:
+            object_cache_free(reinterpret_cast<SlabHeader*>(base), ptr);
+            break;
+        case HeapKind::huge:
+            if (ptr == reinterpret_cast<unsigned char*>(base) + reinterpret_cast<HugeHeader*>(base)->offset) huge_free(reinterpret_cast<HugeHeader*>(base));
+            break;
+        case HeapKind::block:
+            allocator_free(ptr);
+            break;
+        default:
+            break;   // not a heap pointer
+    }
 }
 
 // -----------------------------
 // Public C API (malloc/free/calloc/realloc)
 // -----------------------------
-void* malloc(std::size_t size) { return allocator_alloc(size, alignof(std::max_align_t)); }
-void free(void* ptr) { allocator_free(ptr); }
+void* malloc(std::size_t size) { return heap_alloc(size); }
+void free(void* ptr) { heap_free(ptr); }
+void* aligned_alloc(std::size_t alignment, std::size_t size) {
+    if (!is_power_of_two(alignment)) return nullptr;
+    return heap_alloc(size, alignment);
+}
+int posix_memalign(void** memptr, std::size_t alignment, std::size_t size) {
+    if (!is_power_of_two(alignment) || alignment % sizeof(void*)) return 22;   // EINVAL
+    void* p = heap_alloc(size, alignment);
+    if (!p) return 12;                                                          // ENOMEM
+    *memptr = p;
+    return 0;
+}
 void* calloc(std::size_t nmemb, std::size_t size) {
-    std::size_t total = nmemb * size;
+    std::size_t total;
+    if (__builtin_mul_overflow(nmemb, size, &total)) return nullptr;
+    // huge requests are mapped from the zeroed-page pool and need no clearing
+    if (heap_backend && total >= heap_backend->huge_threshold) return huge_alloc(total, alignof(std::max_align_t), true);
     void* p = malloc(total);
-    if (p) {
-        unsigned char* d = reinterpret_cast<unsigned char*>(p);
-        for (std::size_t i = 0; i < total; ++i) d[i] = 0;
-    }
+    if (p) memset(p, 0, total);
     return p;
 }
 void* realloc(void* ptr, std::size_t newsize) {
     if (!ptr) return malloc(newsize);
     if (newsize == 0) { free(ptr); return nullptr; }
+    if (heap_resize(ptr, newsize)) return ptr;
+
+    // has to move
     void* newptr = malloc(newsize);
     if (!newptr) return nullptr;
-    // simple copy; find old size
-    unsigned char* hdr_candidate = reinterpret_cast<unsigned char*>(ptr) - header_size_aligned;
-    BlockHeader* h = reinterpret_cast<BlockHeader*>(hdr_candidate);
-    std::size_t oldsize = block_size(h) - header_size_aligned - footer_size();
-    std::size_t tocopy = (oldsize < newsize) ? oldsize : newsize;
-    unsigned char* s = reinterpret_cast<unsigned char*>(ptr);
-    unsigned char* d = reinterpret_cast<unsigned char*>(newptr);
-    for (std::size_t i = 0; i < tocopy; ++i) d[i] = s[i];
+    std::size_t oldsize = allocation_size(ptr);
+    memcpy(newptr, ptr, (oldsize < newsize) ? oldsize : newsize);
     free(ptr);
     return newptr;
 }
@@ -276,11 +768,11 @@ void* operator new[](std::size_t size) { return operator new(size); }
 void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return malloc(size); }
 void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return malloc(size); }
 
-void* operator new(std::size_t size, const std::align_val_t /*al*/) { return malloc(size); }
-void* operator new[](std::size_t size, const std::align_val_t /*al*/) { return operator new(size); }
+void* operator new(std::size_t size, const std::align_val_t al) { return aligned_alloc(static_cast<std::size_t>(al), size); }
+void* operator new[](std::size_t size, const std::align_val_t al) { return operator new(size, al); }
 
-void* operator new(std::size_t size, const std::align_val_t /*al*/, const std::nothrow_t&) noexcept { return malloc(size); }
-void* operator new[](std::size_t size, const std::align_val_t /*al*/, const std::nothrow_t&) noexcept { return operator new(size); }
+void* operator new(std::size_t size, const std::align_val_t al, const std::nothrow_t&) noexcept { return aligned_alloc(static_cast<std::size_t>(al), size); }
+void* operator new[](std::size_t size, const std::align_val_t al, const std::nothrow_t&) noexcept { return aligned_alloc(static_cast<std::size_t>(al), size); }
 
 void operator delete(void* ptr) noexcept { free(ptr); }
 void operator delete[](void* ptr) noexcept { free(ptr); }
@@ -288,6 +780,7 @@ void operator delete[](void* ptr) noexcept { free(ptr); }
 void operator delete(void* ptr, std::size_t) noexcept { free(ptr); }
 void operator delete[](void* ptr, std::size_t) noexcept { free(ptr); }
 
+// aligned blocks free like any other: every layer finds its header from the pointer alone
 void operator delete(void* ptr, const std::align_val_t) noexcept { free(ptr); }
 void operator delete[](void* ptr, const std::align_val_t) noexcept { free(ptr); }
 
@@ -320,23 +813,26 @@ struct AtexitEntry { at_exit_fn fn; void* obj; void* dso; };
 constexpr std::size_t ATEXIT_CAP = 256;
 static AtexitEntry atexit_table[ATEXIT_CAP];
 static std::size_t atexit_count = 0;
+static feron::sync::spinlock_t atexit_lock;
 int __cxa_atexit(void (*f)(void*), void* p, void* d) {
     if (!f) return 1;
-    spin_lock();
-    if (atexit_count >= ATEXIT_CAP) { spin_unlock(); return 1; }
+    feron::sync::irq_lock_guard g(atexit_lock);
+    if (atexit_count >= ATEXIT_CAP) return 1;
     atexit_table[atexit_count++] = { f,p,d };
-    spin_unlock();
     return 0;
 }
 void __cxa_finalize(void* d) {
-    spin_lock();
     for (std::ptrdiff_t i = static_cast<std::ptrdiff_t>(atexit_count) - 1; i >= 0; --i) {
-        if (d == nullptr || atexit_table[i].dso == d) {
-            if (atexit_table[i].fn) atexit_table[i].fn(atexit_table[i].obj);
+        AtexitEntry e;
+        {
+            // destructors run unlocked: they may free or register more handlers
+            feron::sync::irq_lock_guard g(atexit_lock);
+            e = atexit_table[i];
+            if (d != nullptr && e.dso != d) continue;
             atexit_table[i].fn = nullptr;
         }
+        if (e.fn) e.fn(e.obj);
     }
-    spin_unlock();
 }
 
 // -----------------------------
@@ -345,14 +841,20 @@ void __cxa_finalize(void* d) {
 extern "C" {
 
 void* memcpy(void* dest, const void* src, std::size_t n) {
-    unsigned char* d = reinterpret_cast<unsigned char*>(dest);
-    const unsigned char* s = reinterpret_cast<const unsigned char*>(src);
-    while (n--) *d++ = *s++;
+    // quadwords first, then the odd bytes
+    void* d = dest;
+    std::size_t q = n / 8, r = n % 8;
+    asm volatile("rep movsq" : "+D"(d), "+S"(src), "+c"(q) : : "memory");
+    asm volatile("rep movsb" : "+D"(d), "+S"(src), "+c"(r) : : "memory");
     return dest;
 }
 void* memset(void* s, int c, std::size_t n) {
-    unsigned char* d = reinterpret_cast<unsigned char*>(s);
-    while (n--) *d++ = static_cast<unsigned char>(c);
+    // the byte broadcast to a quadword, then the odd bytes
+    void* d = s;
+    uint64_t v = 0x0101010101010101ull * static_cast<unsigned char>(c);
+    std::size_t q = n / 8, r = n % 8;
+    asm volatile("rep stosq" : "+D"(d), "+c"(q) : "a"(v) : "memory");
+    asm volatile("rep stosb" : "+D"(d), "+c"(r) : "a"(v) : "memory");
     return s;
 }
 void* memmove(void* dest, const void* src, std::size_t n) {
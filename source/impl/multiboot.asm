@@ -1,11 +1,17 @@
 ; source/impl/multiboot.asm
+; The kernel is linked at KERNEL_VMA + load address (see linker.ld). Everything GRUB
+; jumps into before paging is on lives in the .boot.* sections, which are linked at
+; their physical addresses; the rest of the image is only reachable once the
+; trampoline tables below map it at -2 GiB.
 BITS 32
 GLOBAL _start
 GLOBAL pml4
 GLOBAL pdpt
+GLOBAL pdpt_high
 GLOBAL pd0
 extern kernel_main
-extern kernel_main
+
+HHDM_BASE equ 0xFFFF800000000000        ; mm::config::hhdm_base
 
 SECTION .multiboot
 align 8
@@ -18,13 +24,18 @@ mb2_header_start:
     dd 8
 mb2_header_end:
 
-SECTION .bss
+SECTION .boot.bss nobits alloc noexec write align=4096
 align 4096
-pml4:    resb 4096
-pdpt:    resb 4096
-pd0:     resb 4096
+pml4:      resb 4096
+pdpt:      resb 4096
+pdpt_high: resb 4096
+pd0:       resb 4096*4             ; four page directories: 0..4 GiB in 2 MiB pages
 
-SECTION .data
+align 8
+saved_magic: resd 1
+saved_mbi:   resd 1
+
+SECTION .boot.data progbits alloc noexec write align=8
 align 8
 gdt64:
     dq 0x0000000000000000                ; null
@@ -34,12 +45,20 @@ gdt64_ptr:
     dw (3*8)-1
     dd gdt64
 
-SECTION .bss
+SECTION .data
 align 8
-saved_magic: resd 1
-saved_mbi:   resd 1
+; the same GDT through the direct map, which stays valid once the identity window is gone
+gdt64_ptr_hhdm:
+    dw (3*8)-1
+    dq gdt64 + HHDM_BASE
 
-SECTION .text
+SECTION .bss
+; boot stack lives inside the image, so the frame allocator sees it as used
+align 16
+boot_stack:     resb 65536
+boot_stack_top:
+
+SECTION .boot.text progbits alloc exec nowrite align=16
 BITS 32
 _start:
     ; save Multiboot2 args (eax=magic, ebx=mbi)
@@ -51,37 +70,57 @@ _start:
     or  eax, 1 << 5
     mov cr4, eax
 
-    ; clear tables
+    ; clear tables (pml4, pdpt, pdpt_high and the four PDs are contiguous)
     lea edi, [pml4]
-    mov ecx, 4096/4
-    xor eax, eax
-    rep stosd
-
-    lea edi, [pdpt]
-    mov ecx, 4096/4
+    mov ecx, 7*4096/4
     xor eax, eax
     rep stosd
 
+    ; PD0..PD3: 2048 huge pages mapping 0..4 GiB
+    ; (early allocator metadata and the bootstrap heap live anywhere below 4 GiB)
     lea edi, [pd0]
-    mov ecx, 4096/4
-    xor eax, eax
-    rep stosd
-
-    ; PD0: 2 MiB huge page for 0..2MiB
-    mov dword [pd0], 0x00000083
-    mov dword [pd0+4], 0x00000000
-
-    ; PDPT -> PD0
+    mov eax, 0x00000083           ; present | rw | 2 MiB
+    xor edx, edx                  ; physical address bits 32..63
+    mov ecx, 2048
+.map_pd:
+    mov [edi], eax
+    mov [edi+4], edx
+    add eax, 0x200000
+    adc edx, 0
+    add edi, 8
+    loop .map_pd
+
+    ; PDPT[0..3] -> PD0..PD3
+    lea edi, [pdpt]
     mov eax, pd0
     or  eax, 0x003
-    mov [pdpt], eax
-    mov dword [pdpt+4], 0
+    mov ecx, 4
+.map_pdpt:
+    mov [edi], eax
+    mov dword [edi+4], 0
+    add eax, 4096
+    add edi, 8
+    loop .map_pdpt
+
+    ; PDPT_HIGH[510] -> PD0: the first GiB again at KERNEL_VMA, where the image is linked
+    mov eax, pd0
+    or  eax, 0x003
+    mov [pdpt_high + 510*8], eax
+    mov dword [pdpt_high + 510*8 + 4], 0
 
-    ; PML4 -> PDPT
+    ; PML4[0] -> PDPT (identity, only for this trampoline),
+    ; PML4[256] -> PDPT (direct map at 0xFFFF800000000000),
+    ; PML4[511] -> PDPT_HIGH (kernel image at -2 GiB)
     mov eax, pdpt
     or  eax, 0x003
     mov [pml4], eax
     mov dword [pml4+4], 0
+    mov [pml4 + 256*8], eax
+    mov dword [pml4 + 256*8 + 4], 0
+    mov eax, pdpt_high
+    or  eax, 0x003
+    mov [pml4 + 511*8], eax
+    mov dword [pml4 + 511*8 + 4], 0
 
     ; load CR3
     mov eax, pml4
@@ -106,16 +145,23 @@ _start:
 
 BITS 64
 long_mode_entry:
-    ; set up a stack within identity-mapped region (adjust once you map more)
-    mov rsp, 0x0000000000200000
-
-    ; load saved args (zero-extend to 64-bit)
+    ; load saved args (zero-extend to 64-bit) while the trampoline data is still reachable
     mov eax, dword [saved_magic]
     mov ebx, dword [saved_mbi]
     mov rdi, rax                  ; arg1: magic
-    mov rsi, rbx                  ; arg2: mbi pointer (identity mapped)
+    mov rsi, rbx                  ; arg2: mbi physical address (reach it through the direct map)
+
+    ; leave the identity window: continue at the linked (higher-half) address
+    mov rax, higher_half_entry
+    jmp rax
+
+SECTION .text
+BITS 64
+higher_half_entry:
+    ; set up the boot stack (in .bss, covered by the kernel image reservation)
+    mov rsp, boot_stack_top
+    lgdt [gdt64_ptr_hhdm]
 
-    extern kernel_main
     sti
     call kernel_main
 
@@ -47,6 +47,10 @@ namespace feron::boot::mb2 {
 
         // framebuffer (if present)
         framebuffer_t framebuffer{};
+
+        // the boot information structure itself (must stay intact while info_t is in use)
+        uintptr_t mbi_addr = 0;
+        uint32_t mbi_size = 0;
     };
 
     inline std::size_t align_up(std::size_t n, std::size_t a) {
@@ -62,6 +66,8 @@ namespace feron::boot::mb2 {
         uint32_t total_size = *reinterpret_cast<uint32_t*>(base);
         // safety: require at least header
         if (total_size < 8) return info;
+        info.mbi_addr = reinterpret_cast<uintptr_t>(mbi);
+        info.mbi_size = total_size;
 
         uint8_t* cur = base + 8; // skip size + reserved
         uint8_t* end_all = base + total_size;
@@ -150,4 +156,23 @@ namespace feron::boot::mb2 {
         return info;
     }
 
+    // Walk the module tags and call fn(start, end) with each module's physical range
+    template <typename F>
+    inline void for_each_module(const info_t& info, F&& fn) {
+        if (!info.modules || !info.mbi_addr) return;
+        uint8_t* cur = reinterpret_cast<uint8_t*>(const_cast<module_t*>(info.modules));
+        uint8_t* end_all = reinterpret_cast<uint8_t*>(info.mbi_addr) + info.mbi_size;
+
+        while (cur + sizeof(tag_t) <= end_all) {
+            auto* tag = reinterpret_cast<tag_t*>(cur);
+            if (tag->type == 0 || tag->size < sizeof(tag_t) || cur + tag->size > end_all) break;
+            if (tag->type == 3 && tag->size >= sizeof(tag_t) + 8) {
+                uint32_t mod_start = *reinterpret_cast<uint32_t*>(cur + sizeof(tag_t) + 0);
+                uint32_t mod_end   = *reinterpret_cast<uint32_t*>(cur + sizeof(tag_t) + 4);
+                if (mod_end > mod_start) fn(static_cast<uint64_t>(mod_start), static_cast<uint64_t>(mod_end));
+            }
+            cur += align_up(tag->size, 8);
+        }
+    }
+
 } // namespace feron::boot::mb2
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+// Which CPU and which execution level (thread or interrupt) the caller runs at.
+// Per-CPU data is indexed by [id()][level()] so a handler never shares state with
+// the code it interrupted.
+namespace feron::cpu::context {
+    constexpr uint32_t MAX_CPUS = 8;
+
+    enum level_t : uint32_t { LEVEL_THREAD = 0, LEVEL_IRQ = 1, LEVEL_COUNT = 2 };
+
+    inline volatile uint32_t irq_depth[MAX_CPUS] = {};
+
+    // Single core for now; becomes the APIC id lookup once APs are brought up
+    inline uint32_t id() { return 0; }
+
+    inline uint32_t level() { return irq_depth[id()] ? LEVEL_IRQ : LEVEL_THREAD; }
+
+    // Bracket every interrupt/exception handler that may allocate
+    inline void irq_enter() { uint32_t c = id(); irq_depth[c] = irq_depth[c] + 1; }
+    inline void irq_exit()  { uint32_t c = id(); irq_depth[c] = irq_depth[c] - 1; }
+}
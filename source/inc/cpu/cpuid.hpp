@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+namespace feron::cpu::cpuid {
+    struct regs_t {
+        uint32_t eax, ebx, ecx, edx;
+    };
+
+    inline regs_t query(uint32_t leaf, uint32_t subleaf = 0) {
+        regs_t r;
+        asm volatile("cpuid" : "=a"(r.eax), "=b"(r.ebx), "=c"(r.ecx), "=d"(r.edx) : "a"(leaf), "c"(subleaf));
+        return r;
+    }
+
+    inline uint32_t max_extended_leaf() { return query(0x80000000u).eax; }
+
+    // Global pages (CPUID.01h:EDX.PGE[bit 13])
+    inline bool has_pge() { return query(1).edx & (1u << 13); }
+
+    // Process-context identifiers (CPUID.01h:ECX.PCID[bit 17])
+    inline bool has_pcid() { return query(1).ecx & (1u << 17); }
+
+    // Execute-disable bit (CPUID.80000001h:EDX.NX[bit 20])
+    inline bool has_nx() {
+        return max_extended_leaf() >= 0x80000001u && (query(0x80000001u).edx & (1u << 20));
+    }
+
+    // 1 GiB pages (CPUID.80000001h:EDX.Page1GB[bit 26])
+    inline bool has_1g_pages() {
+        return max_extended_leaf() >= 0x80000001u && (query(0x80000001u).edx & (1u << 26));
+    }
+}
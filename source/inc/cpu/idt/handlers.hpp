@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include "../../tty/tty.hpp"
+#include "../context.hpp"
 #include "settings.hpp"
 #include "idt.hpp"
 
@@ -127,9 +128,18 @@ namespace feron::cpu::idt::handlers {
         for (;;) asm volatile("hlt");
     }
 
+    // Set by mm: resolves faults on demand-paged memory; returns true when the access can be retried
+    inline bool (*page_fault_hook)(uint64_t addr, uint64_t error_code) = nullptr;
+
     extern "C" inline __attribute__((interrupt))
     void isr_page_fault(interrupt_frame* frame, uint64_t error_code) {
         uint64_t cr2 = 0; asm volatile("mov %%cr2, %0" : "=r"(cr2));
+
+        feron::cpu::context::irq_enter();
+        bool handled = page_fault_hook && page_fault_hook(cr2, error_code);
+        feron::cpu::context::irq_exit();
+        if (handled) return;
+
         render_banner(EXNAMES[14]);
         render_frame(frame);
         print_kv_hex("CR2 (fault addr)", cr2);
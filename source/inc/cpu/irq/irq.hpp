@@ -10,6 +10,7 @@
 #include "../../events/second.hpp"
 #include "../../events/minute.hpp"
 #include "../../events/hour.hpp"
+#include "../context.hpp"
 #include "keyboard.hpp"
 
 // IRQ vectors after PIC remap: 32..47
@@ -29,6 +30,7 @@ namespace feron::cpu::irq {
     // --- IRQ0: PIT timer ---
     extern "C" inline __attribute__((interrupt))
     void isr_irq0(InterruptFrame* /*frame*/) {
+        feron::cpu::context::irq_enter();
         static uint64_t ticks = 0;
         ++ticks;
 
@@ -42,11 +44,14 @@ namespace feron::cpu::irq {
 
         // End of interrupt
         pic::pic_eoi(0);
+        feron::cpu::context::irq_exit();
     }
 
     // --- IRQ1: Keyboard ---
     extern "C" inline __attribute__((interrupt))
     void isr_irq1(InterruptFrame* /*frame*/) {
+        feron::cpu::context::irq_enter();
+
         // Read scancode from port 0x60
         uint8_t sc = io::inb(0x60);
 
@@ -63,6 +68,7 @@ namespace feron::cpu::irq {
 
         // End of interrupt
         pic::pic_eoi(1);
+        feron::cpu::context::irq_exit();
     }
 
     // --- Registration into IDT ---
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+namespace feron::cpu::msr {
+    constexpr uint32_t IA32_EFER = 0xC0000080;
+    constexpr uint64_t EFER_NXE  = 1ull << 11;
+
+    inline uint64_t read(uint32_t msr) {
+        uint32_t lo, hi;
+        asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+        return (static_cast<uint64_t>(hi) << 32) | lo;
+    }
+
+    inline void write(uint32_t msr, uint64_t value) {
+        asm volatile("wrmsr" : : "c"(msr), "a"(static_cast<uint32_t>(value)), "d"(static_cast<uint32_t>(value >> 32)) : "memory");
+    }
+}
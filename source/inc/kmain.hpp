@@ -34,12 +34,9 @@ inline void trigger_pf_unmap_then_touch() {
         feron::tty::writeln("PF test: map_page failed"); return;
     }
 
-    // Unmap the leaf to force a #PF on touch
-    if (auto leaf = feron::mm::paging::walk_create(va)) {
-        *leaf = 0;
-        feron::mm::paging::invlpg(va);
-    } else {
-        feron::tty::writeln("PF test: walk_create failed"); return;
+    // Unmap the page to force a #PF on touch
+    if (!feron::mm::paging::unmap_range(va, feron::mm::pfa::PAGE_SIZE)) {
+        feron::tty::writeln("PF test: unmap_range failed"); return;
     }
 
     volatile uint8_t* bad = reinterpret_cast<volatile uint8_t*>(va);
@@ -65,8 +62,8 @@ namespace feron {
         tty::clear(tty::LIGHT_GRAY, tty::BLACK);
         tty::writeln("feron booted !!!");
 
-        // Parse multiboot info
-        auto info = feron::boot::mb2::parse(mbi);
+        // Parse multiboot info; the loader passes its physical address, read it through the direct map
+        auto info = feron::boot::mb2::parse(feron::mm::phys_to_virt(reinterpret_cast<uint64_t>(mbi)));
 
         if (info.bootloader) {
             tty::write("bootloader: \""); tty::write(info.bootloader); tty::writeln("\"");
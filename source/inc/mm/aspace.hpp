@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cstdint>
+#include "../runtime/impl/mem/cpy.hpp"
+#include "../sync/spinlock.hpp"
+#include "hhdm.hpp"
+#include "paging.hpp"
+#include "pfa.hpp"
+
+// Address spaces. Each one owns a PML4 whose lower half is private and whose upper
+// (kernel) half points at the kernel's PDPTs, which paging::init creates up front.
+// Frames mapped in the private half are owned by the space: each mapping holds one
+// page reference, and clone() shares them copy-on-write instead of copying.
+namespace feron::mm::aspace {
+    // Private PML4 slots: the whole lower half, the kernel lives entirely in the upper one
+    constexpr uint64_t USER_FIRST_SLOT = 0;
+    constexpr uint64_t USER_END_SLOT   = 256;
+
+    struct address_space_t {
+        uint64_t  pml4_pa = 0;
+        uint64_t* pml4 = nullptr;
+        feron::sync::spinlock_t lock;   // serializes table edits, clones and COW faults
+        uint16_t  pcid = 0;             // TLB tag, valid while pcid_gen matches the allocator's
+        uint64_t  pcid_gen = 0;
+        bool      stale = false;        // tables changed while inactive: next activation must flush its tag
+    };
+
+    inline address_space_t kernel_space;
+    inline address_space_t* current = &kernel_space;
+
+    // PCID allocator. Tags are handed out in order; when they run out a new generation
+    // starts, every tag is flushed once, and spaces pick up a fresh tag on next activation.
+    constexpr uint16_t PCID_COUNT = 4096;   // PCID 0 stays with the kernel space
+    inline uint64_t pcid_generation = 1;
+    inline uint16_t pcid_next = 1;
+
+    // Note that as's tables changed while another space was active
+    inline void mark_modified(address_space_t& as) {
+        if (&as != current) as.stale = true;
+    }
+
+    // Adopt the tables paging::init built
+    inline void init() {
+        kernel_space.pml4_pa = feron::mm::paging::PML4_pa;
+        kernel_space.pml4 = feron::mm::paging::PML4_va;
+        current = &kernel_space;
+    }
+
+    // Empty private half, shared kernel half
+    inline bool create(address_space_t& as) {
+        uint64_t pa = feron::mm::paging::alloc_table_pa();
+        if (!pa) return false;
+        as.pml4_pa = pa;
+        as.pml4 = feron::mm::phys_to_virt<uint64_t>(pa);
+        for (uint64_t slot = 256; slot < 512; ++slot) as.pml4[slot] = kernel_space.pml4[slot];
+        // a reused descriptor must not inherit a tag that still has entries in the TLB
+        as.pcid = 0;
+        as.pcid_gen = 0;
+        as.stale = true;
+        return true;
+    }
+
+    // Drop the reference a private leaf holds; frames without a live descriptor
+    // (device windows, reserved memory) were never counted
+    inline void release_leaf(uint64_t entry, int level) {
+        uint64_t pa = entry & feron::mm::paging::P_ADDR & ~(feron::mm::paging::level_size(level) - 1);
+        page_t* pg = feron::mm::pfa::page_of(pa);
+        if (pg && pg->refcount && !(pg->flags & PG_RESERVED)) feron::mm::pfa::put_page(pa);
+    }
+
+    inline void release_table(uint64_t* t, int level) {
+        using namespace feron::mm::paging;
+        for (uint64_t i = 0; i < 512; ++i) {
+            uint64_t e = t[i];
+            if (!(e & P_PRESENT)) continue;
+            if (level > 1 && !(e & P_PS)) {
+                release_table(table_at(e), level - 1);
+                free_table(e & P_ADDR);
+            } else {
+                release_leaf(e, level);
+            }
+            t[i] = 0;
+        }
+    }
+
+    // Free the private half and the PML4 (as must not be the active space)
+    inline void destroy(address_space_t& as) {
+        if (!as.pml4 || &as == current || &as == &kernel_space) return;
+        for (uint64_t slot = USER_FIRST_SLOT; slot < USER_END_SLOT; ++slot) {
+            uint64_t e = as.pml4[slot];
+            if (!(e & feron::mm::paging::P_PRESENT)) continue;
+            release_table(feron::mm::paging::table_at(e), 3);
+            feron::mm::paging::free_table(e & feron::mm::paging::P_ADDR);
+        }
+        feron::mm::paging::free_table(as.pml4_pa);
+        as.pml4 = nullptr;
+        as.pml4_pa = 0;
+        // the tag may still cache translations to the frames just freed: never reuse it unflushed
+        as.pcid_gen = 0;
+        as.stale = true;
+    }
+
+    // Make as the active space. With PCIDs its TLB entries survive the switch, and the
+    // kernel's global entries always do; only a new or stale tag is flushed.
+    inline void activate(address_space_t& as) {
+        if (!as.pml4) return;
+        uint64_t cr3 = as.pml4_pa;
+
+        if (feron::mm::paging::pcid) {
+            if (&as != &kernel_space && as.pcid_gen != pcid_generation) {
+                if (pcid_next == PCID_COUNT) {
+                    ++pcid_generation;
+                    pcid_next = 1;
+                    feron::mm::paging::flush_global();
+                }
+                as.pcid = pcid_next++;
+                as.pcid_gen = pcid_generation;
+                as.stale = true;
+            }
+            cr3 |= as.pcid;
+            if (!as.stale) cr3 |= feron::mm::paging::CR3_NOFLUSH;
+        }
+        as.stale = false;
+
+        current = &as;
+        feron::mm::paging::PML4_va = as.pml4;
+        asm volatile("mov %0, %%cr3" : : "r"(cr3) : "memory");
+    }
+
+    // Copy table src (at level) for a clone. Counted writable 4 KiB leaves become read-only
+    // COW in both spaces; read-only leaves are simply shared. Writable 2 MiB leaves are
+    // copied outright (a huge frame has one reference count), 1 GiB ones are split first.
+    inline uint64_t clone_table(uint64_t* src, int level, bool& parent_changed) {
+        using namespace feron::mm::paging;
+        uint64_t dst_pa = alloc_table_pa();
+        if (!dst_pa) return 0;
+        uint64_t* dst = feron::mm::phys_to_virt<uint64_t>(dst_pa);
+        auto fail = [&]() -> uint64_t {
+            release_table(dst, level);
+            free_table(dst_pa);
+            return 0;
+        };
+
+        for (uint64_t i = 0; i < 512; ++i) {
+            uint64_t& e = src[i];
+            if (!(e & P_PRESENT)) continue;
+
+            if (level == 3 && (e & P_PS) && (e & P_RW)) {
+                if (!split_leaf(e, 3)) return fail();
+                parent_changed = true;
+            }
+
+            if (level > 1 && !(e & P_PS)) {
+                uint64_t child = clone_table(table_at(e), level - 1, parent_changed);
+                if (!child) return fail();
+                dst[i] = child | (e & ~P_ADDR);
+                continue;
+            }
+
+            uint64_t pa = e & P_ADDR & ~(level_size(level) - 1);
+            page_t* pg = feron::mm::pfa::page_of(pa);
+            bool counted = pg && pg->refcount && !(pg->flags & PG_RESERVED);
+
+            if (level == 2 && (e & P_RW) && counted) {
+                uint64_t copy = feron::mm::pfa::alloc_pages(9);
+                if (!copy) return fail();
+                memcpy(feron::mm::phys_to_virt(copy), feron::mm::phys_to_virt(pa), SIZE_2M);
+                dst[i] = copy | (e & ~P_ADDR) | (e & P_PAT_HUGE);
+                continue;
+            }
+
+            if (counted) {
+                if (level == 1 && (e & P_RW)) {
+                    e = (e & ~P_RW) | P_COW;
+                    parent_changed = true;
+                }
+                feron::mm::pfa::get_page(pg);
+            }
+            dst[i] = e;
+        }
+        return dst_pa;
+    }
+
+    // Fork-style clone of src's private half into dst (a fresh address space)
+    inline bool clone(address_space_t& src, address_space_t& dst) {
+        if (!src.pml4 || !create(dst)) return false;
+
+        bool parent_changed = false, ok = true;
+        {
+            feron::sync::irq_lock_guard g(src.lock);
+            for (uint64_t slot = USER_FIRST_SLOT; slot < USER_END_SLOT && ok; ++slot) {
+                uint64_t e = src.pml4[slot];
+                if (!(e & feron::mm::paging::P_PRESENT)) continue;
+                uint64_t child = clone_table(feron::mm::paging::table_at(e), 3, parent_changed);
+                if (!child) ok = false;
+                else dst.pml4[slot] = child | (e & ~feron::mm::paging::P_ADDR);
+            }
+        }
+
+        // the parent lost write access to its private pages
+        if (parent_changed) {
+            if (&src == current) feron::mm::paging::flush_all();
+            else mark_modified(src);
+        }
+        if (!ok) destroy(dst);
+        return ok;
+    }
+
+    // Resolve a write to a COW page of the active space: the last holder just regains
+    // write access, anyone else gets a private copy of the touched page
+    inline bool handle_fault(uint64_t addr, uint64_t error_code) {
+        using namespace feron::mm::paging;
+        if ((error_code & 3) != 3) return false; // only writes to present pages
+        address_space_t& as = *current;
+
+        feron::sync::irq_lock_guard g(as.lock);
+        uint64_t* pte = lookup(as.pml4, addr, 1);
+        if (!pte || !(*pte & P_COW)) return false;
+
+        const uint64_t page = addr & ~(SIZE_4K - 1);
+        uint64_t old = *pte & P_ADDR;
+        page_t* pg = feron::mm::pfa::page_of(old);
+
+        if (pg && pg->refcount == 1) {
+            *pte = (*pte & ~P_COW) | P_RW;
+        } else {
+            uint64_t copy = feron::mm::pfa::alloc_page();
+            if (!copy) return false;
+            memcpy(feron::mm::phys_to_virt(copy), feron::mm::phys_to_virt(old), SIZE_4K);
+            *pte = copy | (*pte & ~(P_ADDR | P_COW)) | P_RW;
+            feron::mm::pfa::put_page(old);
+        }
+        invlpg(page);
+        return true;
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include "../runtime/impl/mem/set.hpp"
+
+// Binary buddy allocator for physically contiguous blocks of 2^order pages.
+// Works purely on page frame numbers; the frames themselves are never touched,
+// so it is usable before any physical memory is mapped.
+namespace feron::mm::buddy {
+    constexpr unsigned MAX_ORDER = 10;               // largest block = 2^10 pages (4 MiB)
+    constexpr uint64_t NO_PFN    = UINT64_MAX;       // returned when nothing fits
+    constexpr uint32_t NIL       = 0xFFFFFFFFu;      // end of a free list
+    constexpr uint8_t  ST_FREE   = 0x80;             // block head is on a free list (low bits = order)
+    constexpr uint8_t  ST_NONE   = 0xFF;             // page is not a block head
+
+    // Per-order free lists, linked through out-of-band arrays indexed by (pfn - base_pfn)
+    struct free_area_t {
+        uint32_t head = NIL;
+        uint64_t count = 0;
+    };
+
+    inline free_area_t free_area[MAX_ORDER + 1];
+
+    inline uint64_t base_pfn = 0;      // first frame of the arena
+    inline uint64_t arena_pages = 0;   // frames in the arena
+    inline uint64_t free_pages = 0;    // frames currently on a free list
+
+    inline uint32_t* next_link = nullptr;
+    inline uint32_t* prev_link = nullptr;
+    inline uint8_t*  state = nullptr;  // ST_NONE, order of an allocated block, or ST_FREE | order
+
+    inline bool owns(uint64_t pfn) { return arena_pages && pfn >= base_pfn && pfn < base_pfn + arena_pages; }
+
+    inline void list_push(unsigned order, uint32_t idx) {
+        auto& area = free_area[order];
+        next_link[idx] = area.head;
+        prev_link[idx] = NIL;
+        if (area.head != NIL) prev_link[area.head] = idx;
+        area.head = idx;
+        ++area.count;
+        state[idx] = static_cast<uint8_t>(ST_FREE | order);
+        free_pages += 1ull << order;
+    }
+
+    inline void list_remove(unsigned order, uint32_t idx) {
+        auto& area = free_area[order];
+        if (prev_link[idx] != NIL) next_link[prev_link[idx]] = next_link[idx];
+        else area.head = next_link[idx];
+        if (next_link[idx] != NIL) prev_link[next_link[idx]] = prev_link[idx];
+        --area.count;
+        state[idx] = ST_NONE;
+        free_pages -= 1ull << order;
+    }
+
+    // Allocate 2^order contiguous frames aligned to their size; O(MAX_ORDER)
+    inline uint64_t alloc(unsigned order) {
+        if (order > MAX_ORDER || !arena_pages) return NO_PFN;
+
+        unsigned o = order;
+        while (o <= MAX_ORDER && free_area[o].head == NIL) ++o;
+        if (o > MAX_ORDER) return NO_PFN;
+
+        uint32_t idx = free_area[o].head;
+        list_remove(o, idx);
+
+        // Split down, returning the upper halves to the smaller lists
+        while (o > order) {
+            --o;
+            list_push(o, idx + (1u << o));
+        }
+        state[idx] = static_cast<uint8_t>(order);
+        return base_pfn + idx;
+    }
+
+    // Return a block and merge it with its free buddies; O(MAX_ORDER)
+    inline void free(uint64_t pfn, unsigned order) {
+        if (!owns(pfn) || order > MAX_ORDER) return;
+        uint64_t idx = pfn - base_pfn;
+        if (state[idx] != order) return; // not an allocated block of this order
+        state[idx] = ST_NONE;
+
+        while (order < MAX_ORDER) {
+            uint64_t buddy_pfn = (base_pfn + idx) ^ (1ull << order);
+            if (!owns(buddy_pfn)) break;
+            uint64_t bidx = buddy_pfn - base_pfn;
+            if (state[bidx] != (ST_FREE | order)) break;
+
+            list_remove(order, static_cast<uint32_t>(bidx));
+            if (bidx < idx) idx = bidx;
+            ++order;
+        }
+        list_push(order, static_cast<uint32_t>(idx));
+    }
+
+    // Bytes of metadata needed to manage count frames
+    inline uint64_t storage_bytes(uint64_t count) { return count * (2 * sizeof(uint32_t) + 1); }
+
+    // Take ownership of frames [pfn, pfn + count), carving them into maximal aligned blocks.
+    // storage must hold storage_bytes(count) bytes.
+    inline bool init(uint64_t pfn, uint64_t count, void* storage) {
+        for (auto& area : free_area) area = {};
+        base_pfn = pfn;
+        arena_pages = 0;
+        free_pages = 0;
+        if (!count || count >= NIL || !storage) return false;
+
+        next_link = static_cast<uint32_t*>(storage);
+        prev_link = next_link + count;
+        state     = reinterpret_cast<uint8_t*>(prev_link + count);
+        memset(state, ST_NONE, count);
+        arena_pages = count;
+
+        uint64_t cur = pfn, end = pfn + count;
+        while (cur < end) {
+            unsigned order = MAX_ORDER;
+            while (order && ((cur & ((1ull << order) - 1)) || cur + (1ull << order) > end)) --order;
+            list_push(order, static_cast<uint32_t>(cur - base_pfn));
+            cur += 1ull << order;
+        }
+        return true;
+    }
+}
@@ -3,6 +3,28 @@
 #include <cstdint>
 
 namespace feron::mm::config {
-    inline uint64_t va_pool_base = 0xFFFF800000000000ull;
-    inline uint64_t va_pool_size = 1ull * 1024 * 1024; // 1 MiB
+    // Direct map of physical memory; PML4 slot 256, which the boot trampoline also fills
+    inline uint64_t hhdm_base = 0xFFFF800000000000ull;
+
+    // Dynamic kernel mappings (PML4 slot 384, clear of the direct map)
+    inline uint64_t va_pool_base = 0xFFFFC00000000000ull;
+    inline uint64_t va_pool_size = 64ull * 1024 * 1024 * 1024; // 64 GiB, only touched pages cost memory
+
+    // Link address of the kernel image minus its load address (KERNEL_VMA in linker.ld)
+    inline uint64_t kernel_vma = 0xFFFFFFFF80000000ull;
+
+    // Physical memory the boot trampoline's direct map covers; early metadata lives below it
+    inline uint64_t boot_map_limit = 4ull * 1024 * 1024 * 1024; // 4 GiB
+
+    // Bootstrap kernel heap, carved out by memblock
+    inline uint64_t boot_heap_size = 1ull * 1024 * 1024; // 1 MiB
+
+    // Heap growth once paging is up: chunk granularity, the size from which an allocation
+    // gets a mapping of its own, and how much free chunk memory is kept before chunks are returned
+    inline uint64_t heap_chunk_size = 2ull * 1024 * 1024;        // 2 MiB
+    inline uint64_t heap_huge_threshold = 256ull * 1024;         // 256 KiB
+    inline uint64_t heap_free_high_water = 4ull * 1024 * 1024;   // 4 MiB
+
+    // Physical memory set aside for the buddy allocator (contiguous multi-page blocks)
+    inline uint64_t buddy_arena_size = 32ull * 1024 * 1024; // 32 MiB
 }
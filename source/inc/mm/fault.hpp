@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include "aspace.hpp"
+#include "vmregion.hpp"
+
+namespace feron::mm {
+    // Page-fault hook: copy-on-write first, then demand-paged regions
+    inline bool handle_page_fault(uint64_t addr, uint64_t error_code) {
+        if (feron::mm::aspace::handle_fault(addr, error_code)) return true;
+        return feron::mm::vmregion::handle_fault(addr, error_code);
+    }
+}
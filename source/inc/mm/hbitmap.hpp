@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstdint>
+#include "../runtime/impl/mem/set.hpp"
+
+namespace feron::mm {
+    // Three-level frame bitmap.
+    //   l0: one bit per page, 1 = used
+    //   l1: one bit per l0 word, 1 = that group of 64 pages has a free page
+    //   l2: one bit per l1 word, 1 = that l1 word is non-zero
+    // One l2 word covers 2^18 pages (1 GiB), so a search touches at most a handful
+    // of words no matter how full or how large memory is.
+    struct hbitmap_t {
+        static constexpr uint64_t NONE = UINT64_MAX;
+
+        uint64_t* l0 = nullptr;
+        uint64_t* l1 = nullptr;
+        uint64_t* l2 = nullptr;
+        uint64_t bits = 0;
+        uint64_t l0_words = 0, l1_words = 0, l2_words = 0;
+        uint64_t free = 0;   // clear bits in l0
+        uint64_t hint = 0;   // next-fit cursor (l0 word index)
+
+        static uint64_t words_for(uint64_t n) { return (n + 63) / 64; }
+
+        // Words of backing storage needed for n bits, all levels included
+        static uint64_t storage_words(uint64_t n) {
+            uint64_t w0 = words_for(n), w1 = words_for(w0);
+            return w0 + w1 + words_for(w1);
+        }
+
+        // Lay the levels out in mem (storage_words(n) words). Every bit starts out used.
+        inline void attach(uint64_t* mem, uint64_t n) {
+            bits = n;
+            l0_words = words_for(n);
+            l1_words = words_for(l0_words);
+            l2_words = words_for(l1_words);
+            l0 = mem;
+            l1 = l0 + l0_words;
+            l2 = l1 + l1_words;
+            memset(l0, 0xFF, l0_words * sizeof(uint64_t));
+            memset(l1, 0, (l1_words + l2_words) * sizeof(uint64_t));
+            free = 0;
+            hint = 0;
+        }
+
+        inline bool test(uint64_t i) const { return (l0[i >> 6] >> (i & 63)) & 1; }
+
+        // Recompute the summary bits above l0 word w
+        inline void refresh(uint64_t w) {
+            uint64_t s = w >> 6;
+            if (l0[w] != ~0ull) l1[s] |=  (1ull << (w & 63));
+            else                l1[s] &= ~(1ull << (w & 63));
+            if (l1[s]) l2[s >> 6] |=  (1ull << (s & 63));
+            else       l2[s >> 6] &= ~(1ull << (s & 63));
+        }
+
+        inline void set(uint64_t i) {
+            uint64_t w = i >> 6, m = 1ull << (i & 63);
+            if (l0[w] & m) return;
+            l0[w] |= m;
+            --free;
+            if (l0[w] == ~0ull) refresh(w);
+        }
+
+        inline void clear(uint64_t i) {
+            uint64_t w = i >> 6, m = 1ull << (i & 63);
+            if (!(l0[w] & m)) return;
+            bool was_full = l0[w] == ~0ull;
+            l0[w] &= ~m;
+            ++free;
+            if (was_full) refresh(w);
+        }
+
+        // Bits of word w that fall inside [s, e)
+        static uint64_t range_mask(uint64_t w, uint64_t s, uint64_t e) {
+            uint64_t lo = (w == (s >> 6)) ? (s & 63) : 0;
+            uint64_t hi = (w == ((e - 1) >> 6)) ? ((e - 1) & 63) : 63;
+            return (~0ull << lo) & (~0ull >> (63 - hi));
+        }
+
+        // Set or clear bits [s, e) of a plain bit array, one word at a time
+        static void fill(uint64_t* words, uint64_t s, uint64_t e, bool value) {
+            if (s >= e) return;
+            for (uint64_t w = s >> 6; w <= ((e - 1) >> 6); ++w) {
+                uint64_t m = range_mask(w, s, e);
+                if (value) words[w] |= m;
+                else       words[w] &= ~m;
+            }
+        }
+
+        // Mark [s, e) used
+        inline void reserve_range(uint64_t s, uint64_t e) {
+            if (e > bits) e = bits;
+            if (s >= e) return;
+            uint64_t ws = s >> 6, we = (e - 1) >> 6;
+            for (uint64_t w = ws; w <= we; ++w) {
+                uint64_t m = range_mask(w, s, e);
+                free -= static_cast<uint64_t>(__builtin_popcountll(~l0[w] & m));
+                l0[w] |= m;
+            }
+            // Whole words inside the range are now full; the two edge words may not be
+            fill(l1, (s + 63) >> 6, e >> 6, false);
+            refresh(ws);
+            refresh(we);
+            for (uint64_t x = ws >> 6; x <= (we >> 6); ++x) {
+                if (l1[x]) l2[x >> 6] |=  (1ull << (x & 63));
+                else       l2[x >> 6] &= ~(1ull << (x & 63));
+            }
+        }
+
+        // Mark [s, e) free
+        inline void release_range(uint64_t s, uint64_t e) {
+            if (e > bits) e = bits;
+            if (s >= e) return;
+            uint64_t ws = s >> 6, we = (e - 1) >> 6;
+            for (uint64_t w = ws; w <= we; ++w) {
+                uint64_t m = range_mask(w, s, e);
+                free += static_cast<uint64_t>(__builtin_popcountll(l0[w] & m));
+                l0[w] &= ~m;
+            }
+            // Every touched word now has a free bit, and so does every l1 word above them
+            fill(l1, ws, we + 1, true);
+            fill(l2, ws >> 6, (we >> 6) + 1, true);
+        }
+
+        // True when no bit in [s, e) is set
+        inline bool range_free(uint64_t s, uint64_t e) const {
+            if (e > bits || s >= e) return false;
+            for (uint64_t w = s >> 6; w <= ((e - 1) >> 6); ++w) {
+                if (l0[w] & range_mask(w, s, e)) return false;
+            }
+            return true;
+        }
+
+        // First l0 word at or after w that has a free bit, or NONE
+        inline uint64_t find_from(uint64_t w) const {
+            if (w >= l0_words) return NONE;
+            uint64_t s = w >> 6;
+            uint64_t b1 = l1[s] & (~0ull << (w & 63));
+            if (b1) return (s << 6) | static_cast<uint64_t>(__builtin_ctzll(b1));
+
+            if (++s >= l1_words) return NONE;
+            uint64_t t = s >> 6;
+            uint64_t b2 = l2[t] & (~0ull << (s & 63));
+            for (;;) {
+                if (b2) {
+                    uint64_t s2 = (t << 6) | static_cast<uint64_t>(__builtin_ctzll(b2));
+                    return (s2 << 6) | static_cast<uint64_t>(__builtin_ctzll(l1[s2]));
+                }
+                if (++t >= l2_words) return NONE;
+                b2 = l2[t];
+            }
+        }
+
+        // Next-fit search: from the cursor to the end, then wrap once
+        inline uint64_t find_free_word() const {
+            uint64_t w = find_from(hint);
+            if (w == NONE && hint) w = find_from(0);
+            return w;
+        }
+
+        // Claim the lowest free bit of l0 word w (which must have one)
+        inline uint64_t take_from(uint64_t w) {
+            uint64_t bit = static_cast<uint64_t>(__builtin_ctzll(~l0[w]));
+            l0[w] |= 1ull << bit;
+            --free;
+            if (l0[w] == ~0ull) refresh(w);
+            hint = w;
+            return (w << 6) | bit;
+        }
+
+        // Allocate one bit; returns its index or NONE
+        inline uint64_t alloc() {
+            uint64_t w = find_free_word();
+            return w == NONE ? NONE : take_from(w);
+        }
+    };
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include "config.hpp"
+
+// Higher-half direct map: all physical memory is mapped once at config::hhdm_base,
+// so any frame is reachable with plain pointer arithmetic. The boot trampoline
+// provides the first 4 GiB of it; paging::init extends it over all RAM.
+namespace feron::mm {
+    inline uint64_t hhdm_size = 4ull * 1024 * 1024 * 1024;   // physical bytes currently covered
+
+    template <typename T = void>
+    inline T* phys_to_virt(uint64_t pa) {
+        return reinterpret_cast<T*>(pa + feron::mm::config::hhdm_base);
+    }
+
+    // Only valid for addresses inside the direct map
+    inline uint64_t direct_to_phys(const void* va) {
+        return reinterpret_cast<uint64_t>(va) - feron::mm::config::hhdm_base;
+    }
+
+    inline bool in_direct_map(uint64_t va) {
+        return va >= feron::mm::config::hhdm_base && va - feron::mm::config::hhdm_base < hhdm_size;
+    }
+
+    // Physical address of something inside the kernel image (code, statics, linker symbols)
+    inline uint64_t image_to_phys(const void* va) {
+        return reinterpret_cast<uint64_t>(va) - feron::mm::config::kernel_vma;
+    }
+}
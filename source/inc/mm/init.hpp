@@ -1,17 +1,28 @@
 #pragma once
 
 #include "../runtime/heap_init.hpp"
+#include "aspace.hpp"
 #include "config.hpp"
+#include "fault.hpp"
+#include "memblock.hpp"
 #include "paging.hpp"
 #include "pfa.hpp"
 #include "valloc.hpp"
+#include "vmalloc.hpp"
+#include "vmregion.hpp"
+#include "zeropool.hpp"
+#include "../cpu/idt/handlers.hpp"
 #include "../boot/mb2.hpp"
 
 namespace feron::mm {
     inline void init(boot::mb2::info_t info) {
-        feron::mm::pfa::init(info);
+        // Usable RAM and the ranges already in use, before anything allocates
+        feron::mm::memblock::init(info);
 
-        feron::runtime::init_heap_from_mmap(info);
+        feron::runtime::init_heap_from_memblock();
+
+        // Takes its metadata from memblock and inherits every reservation made so far
+        feron::mm::pfa::init();
 
         feron::mm::valloc::init
         (
@@ -28,5 +39,13 @@ namespace feron::mm {
             0,
             feron::mm::paging::P_PRESENT | feron::mm::paging::P_RW
         );
+
+        feron::mm::aspace::init();
+
+        // Small heap objects now come from slabs of pfa pages
+        feron::runtime::init_heap_backend();
+
+        // Copy-on-write and demand-paged regions are resolved from the #PF handler
+        feron::cpu::idt::handlers::page_fault_hook = feron::mm::handle_page_fault;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "../sync/spinlock.hpp"
+#include "hhdm.hpp"
+#include "page.hpp"
+#include "pfa.hpp"
+
+// Typed object caches. A kmem_cache<T> keeps slabs of pfa pages holding densely packed T
+// objects, reached through the direct map. The optional constructor hook runs on every
+// object when its slab is created and the destructor hook when the slab is released, never
+// on alloc/free: objects go back to the cache still constructed, so an allocation is a pop.
+// Consecutive slabs start their objects at different cache-line offsets (colouring), so the
+// hot first objects of many slabs do not all land in the same cache sets. Slabs are aligned
+// to their size, which is how free() finds the slab header in O(1); every frame of a slab
+// carries PG_KMEM and its cache in page_t, so free() can tell a foreign pointer apart
+// without reading memory it does not own.
+namespace feron::mm {
+    namespace kmem {
+        constexpr std::size_t PAGE      = feron::mm::pfa::PAGE_SIZE;
+        constexpr std::size_t LINE      = 64;
+        constexpr std::size_t MAX_PAGES = 16;       // largest slab
+        constexpr std::size_t MIN_OBJECTS = 8;      // grow the slab until this many fit
+        constexpr uint32_t SLAB_MAGIC   = 0x4B4D454Du;
+
+        struct slab_t {
+            uint32_t magic;
+            uint16_t inuse;
+            uint16_t free_top;              // entries on the free-index stack
+            uint32_t colour;                // byte offset of the first object
+            uint32_t reserved;
+            unsigned char* objects;
+            slab_t* next;
+            slab_t* prev;
+        };
+
+        constexpr std::size_t align_up(std::size_t n, std::size_t a) {
+            return (n + (a - 1)) & ~(a - 1);
+        }
+
+        // Words in the allocated bitmap, which follows the header
+        constexpr std::size_t bitmap_words(std::size_t count) {
+            return (count + 63) / 64;
+        }
+
+        // Header, allocated bitmap and a uint16_t free index per object, rounded to the object alignment
+        constexpr std::size_t header_bytes(std::size_t count, std::size_t align) {
+            return align_up(sizeof(slab_t) + bitmap_words(count) * sizeof(uint64_t) + count * sizeof(uint16_t), align);
+        }
+
+        constexpr std::size_t per_slab(std::size_t pages, std::size_t size, std::size_t align) {
+            std::size_t bytes = pages * PAGE;
+            if (bytes < sizeof(slab_t) + size) return 0;
+            std::size_t n = (bytes - sizeof(slab_t)) / (size + sizeof(uint16_t));   // the bitmap is trimmed below
+            while (n && header_bytes(n, align) + n * size > bytes) --n;
+            return n > 0xFFFF ? 0xFFFF : n;
+        }
+
+        constexpr std::size_t slab_pages(std::size_t size, std::size_t align) {
+            std::size_t pages = 1;
+            while (pages < MAX_PAGES && per_slab(pages, size, align) < MIN_OBJECTS) pages *= 2;
+            return pages;
+        }
+    }
+
+    template <typename T>
+    class kmem_cache {
+    public:
+        using ctor_fn = void (*)(T*);
+        using dtor_fn = void (*)(T*);
+
+        // Constant-initialized, so caches can be plain globals: no global constructors run
+        constexpr explicit kmem_cache(ctor_fn ctor = nullptr, dtor_fn dtor = nullptr) : ctor_(ctor), dtor_(dtor) {}
+
+        kmem_cache(const kmem_cache&) = delete;
+        kmem_cache& operator=(const kmem_cache&) = delete;
+
+        // An object in the state the constructor hook left it (raw storage without one),
+        // or nullptr when no pages are left
+        T* alloc() {
+            {
+                feron::sync::irq_lock_guard g(lock_);
+                if (T* obj = take()) return obj;
+            }
+            // build the slab unlocked: the constructor hook may take locks of its own
+            kmem::slab_t* s = create();
+            if (!s) return nullptr;
+            feron::sync::irq_lock_guard g(lock_);
+            push(partial_, s);
+            ++slabs_;
+            return take();
+        }
+
+        // Return obj in its constructed state. Pointers that are not objects of this cache
+        // are ignored, as are double frees.
+        void free(T* obj) {
+            if (!obj) return;
+            uintptr_t p = reinterpret_cast<uintptr_t>(obj);
+            if (!feron::mm::in_direct_map(p)) return;
+            feron::mm::page_t* pg = feron::mm::pfa::page_of(feron::mm::direct_to_phys(obj));
+            if (!pg || !(pg->flags & PG_KMEM) || pg->owner != reinterpret_cast<uint64_t>(this)) return;
+            auto* s = reinterpret_cast<kmem::slab_t*>(p & ~(SLAB_BYTES - 1));
+            if (s->magic != kmem::SLAB_MAGIC) return;
+            uintptr_t first = reinterpret_cast<uintptr_t>(s->objects);
+            if (p < first || (p - first) % sizeof(T) || (p - first) / sizeof(T) >= PER_SLAB) return;
+
+            std::size_t idx = (p - first) / sizeof(T);
+            uint64_t bit = 1ull << (idx % 64);
+
+            feron::sync::irq_lock_guard g(lock_);
+            if (!(bitmap(s)[idx / 64] & bit)) return;           // double free
+            bitmap(s)[idx / 64] &= ~bit;
+            if (s->free_top == 0) push(partial_, s);             // was full
+            free_stack(s)[s->free_top++] = static_cast<uint16_t>(idx);
+            --s->inuse;
+            --in_use_;
+            if (s->inuse == 0) {
+                unlink(partial_, s);
+                push(empty_, s);
+            }
+        }
+
+        // Release every empty slab, running the destructor hook on its objects.
+        // Returns the number of pages given back.
+        uint64_t shrink() {
+            kmem::slab_t* list;
+            {
+                feron::sync::irq_lock_guard g(lock_);
+                list = empty_;
+                empty_ = nullptr;
+            }
+            uint64_t pages = 0;
+            while (list) {
+                kmem::slab_t* s = list;
+                list = s->next;
+                destroy(s);
+                pages += PAGES;
+            }
+            feron::sync::irq_lock_guard g(lock_);
+            slabs_ -= pages / PAGES;
+            return pages;
+        }
+
+        uint64_t objects_in_use() const { return in_use_; }
+        uint64_t slab_count() const { return slabs_; }
+
+        static constexpr std::size_t PAGES = kmem::slab_pages(sizeof(T), alignof(T));
+        static constexpr std::size_t PER_SLAB = kmem::per_slab(PAGES, sizeof(T), alignof(T));
+        static_assert(PER_SLAB > 0, "object too large for a kmem_cache slab");
+
+    private:
+        static constexpr std::size_t SLAB_BYTES = PAGES * kmem::PAGE;
+        static constexpr std::size_t ORDER = __builtin_ctzll(PAGES);
+        // slack after the objects, spent on colour offsets
+        static constexpr std::size_t SPARE = SLAB_BYTES - kmem::header_bytes(PER_SLAB, alignof(T)) - PER_SLAB * sizeof(T);
+        static constexpr std::size_t COLOUR_STEP = alignof(T) > kmem::LINE ? alignof(T) : kmem::LINE;
+
+        // bit set = object handed out
+        static uint64_t* bitmap(kmem::slab_t* s) {
+            return reinterpret_cast<uint64_t*>(s + 1);
+        }
+
+        static uint16_t* free_stack(kmem::slab_t* s) {
+            return reinterpret_cast<uint16_t*>(bitmap(s) + kmem::bitmap_words(PER_SLAB));
+        }
+
+        static void push(kmem::slab_t*& head, kmem::slab_t* s) {
+            s->prev = nullptr;
+            s->next = head;
+            if (head) head->prev = s;
+            head = s;
+        }
+
+        static void unlink(kmem::slab_t*& head, kmem::slab_t* s) {
+            if (s->prev) s->prev->next = s->next;
+            else head = s->next;
+            if (s->next) s->next->prev = s->prev;
+            s->next = s->prev = nullptr;
+        }
+
+        // Pop an object from the first slab with one free; full slabs leave the lists
+        // (caller holds lock_)
+        T* take() {
+            kmem::slab_t* s = partial_;
+            if (!s && (s = empty_)) {
+                unlink(empty_, s);
+                push(partial_, s);
+            }
+            if (!s) return nullptr;
+            uint16_t idx = free_stack(s)[--s->free_top];
+            bitmap(s)[idx / 64] |= 1ull << (idx % 64);
+            ++s->inuse;
+            ++in_use_;
+            if (s->free_top == 0) unlink(partial_, s);
+            return reinterpret_cast<T*>(s->objects + idx * sizeof(T));
+        }
+
+        kmem::slab_t* create() {
+            uint64_t pa = ORDER ? feron::mm::pfa::alloc_pages(ORDER) : feron::mm::pfa::alloc_page();
+            if (!pa) return nullptr;
+            auto* s = feron::mm::phys_to_virt<kmem::slab_t>(pa);
+            for (std::size_t i = 0; i < PAGES; ++i) {
+                feron::mm::page_t* pg = feron::mm::pfa::page_of(pa + i * kmem::PAGE);
+                pg->flags |= PG_KMEM;
+                pg->owner = reinterpret_cast<uint64_t>(this);
+            }
+
+            uint32_t colour;
+            {
+                feron::sync::irq_lock_guard g(lock_);
+                colour = next_colour_;
+                next_colour_ = next_colour_ + COLOUR_STEP <= SPARE ? next_colour_ + COLOUR_STEP : 0;
+            }
+
+            s->magic = kmem::SLAB_MAGIC;
+            s->inuse = 0;
+            s->colour = colour;
+            s->reserved = 0;
+            s->objects = reinterpret_cast<unsigned char*>(s) + kmem::header_bytes(PER_SLAB, alignof(T)) + colour;
+            s->next = s->prev = nullptr;
+
+            for (std::size_t w = 0; w < kmem::bitmap_words(PER_SLAB); ++w) bitmap(s)[w] = 0;
+
+            // lowest index on top, so objects go out in address order
+            uint16_t* stack = free_stack(s);
+            for (std::size_t i = 0; i < PER_SLAB; ++i) stack[i] = static_cast<uint16_t>(PER_SLAB - 1 - i);
+            s->free_top = static_cast<uint16_t>(PER_SLAB);
+
+            if (ctor_) {
+                for (std::size_t i = 0; i < PER_SLAB; ++i) ctor_(reinterpret_cast<T*>(s->objects + i * sizeof(T)));
+            }
+            return s;
+        }
+
+        void destroy(kmem::slab_t* s) {
+            if (dtor_) {
+                for (std::size_t i = 0; i < PER_SLAB; ++i) dtor_(reinterpret_cast<T*>(s->objects + i * sizeof(T)));
+            }
+            s->magic = 0;
+            uint64_t pa = feron::mm::direct_to_phys(s);
+            for (std::size_t i = 0; i < PAGES; ++i) {
+                feron::mm::page_t* pg = feron::mm::pfa::page_of(pa + i * kmem::PAGE);
+                pg->flags &= static_cast<uint16_t>(~PG_KMEM);
+                pg->owner = 0;
+            }
+            if (ORDER) feron::mm::pfa::free_pages(pa, ORDER);
+            else feron::mm::pfa::free_page(pa);
+        }
+
+        ctor_fn ctor_ = nullptr;
+        dtor_fn dtor_ = nullptr;
+        kmem::slab_t* partial_ = nullptr;      // slabs with free objects and at least one in use
+        kmem::slab_t* empty_ = nullptr;        // fully free slabs, kept until shrink()
+        uint32_t next_colour_ = 0;
+        uint64_t in_use_ = 0;
+        uint64_t slabs_ = 0;
+        feron::sync::spinlock_t lock_;
+    };
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstdint>
+#include "../boot/mb2.hpp"
+#include "hhdm.hpp"
+
+// Linker-provided physical bounds of the loaded kernel image, trampoline included
+extern "C" char __kernel_phys_start[];
+extern "C" char __kernel_phys_end[];
+
+// Early boot allocator. Keeps the usable RAM from the mmap and the ranges already in use
+// (kernel image, boot info, modules, ...) as two sorted range lists, and hands out physical
+// memory before the page allocator exists. pfa::init takes its metadata from here and then
+// inherits every reservation.
+namespace feron::mm::memblock {
+    constexpr uint32_t MAX_RANGES = 128;
+    constexpr uint64_t PAGE = 4096;
+
+    struct range_t {
+        uint64_t base = 0;
+        uint64_t end = 0;    // exclusive
+    };
+
+    // Sorted, non-overlapping list of [base, end) ranges; touching ranges are merged
+    struct range_list_t {
+        range_t ranges[MAX_RANGES];
+        uint32_t count = 0;
+
+        // false when the range needs a new entry and the list is full
+        inline bool add(uint64_t base, uint64_t end) {
+            if (end <= base) return true;
+            uint32_t i = 0;
+            while (i < count && ranges[i].end < base) ++i;
+
+            // absorb every range that overlaps or touches [base, end)
+            uint32_t j = i;
+            while (j < count && ranges[j].base <= end) {
+                if (ranges[j].base < base) base = ranges[j].base;
+                if (ranges[j].end > end) end = ranges[j].end;
+                ++j;
+            }
+
+            if (j == i) {
+                if (count == MAX_RANGES) return false;
+                for (uint32_t k = count; k > i; --k) ranges[k] = ranges[k - 1];
+                ++count;
+            } else {
+                uint32_t removed = j - i - 1;
+                for (uint32_t k = i + 1; k + removed < count; ++k) ranges[k] = ranges[k + removed];
+                count -= removed;
+            }
+            ranges[i] = { base, end };
+            return true;
+        }
+
+        inline void remove(uint64_t base, uint64_t end) {
+            if (end <= base) return;
+            for (uint32_t i = 0; i < count; ++i) {
+                range_t& r = ranges[i];
+                if (r.end <= base || r.base >= end) continue;
+
+                if (r.base < base && r.end > end) {
+                    // hole in the middle: keep the head here, insert the tail after it
+                    if (count == MAX_RANGES) { r.end = base; continue; }
+                    for (uint32_t k = count; k > i + 1; --k) ranges[k] = ranges[k - 1];
+                    ranges[i + 1] = { end, r.end };
+                    r.end = base;
+                    ++count;
+                    ++i;
+                } else if (r.base < base) {
+                    r.end = base;
+                } else if (r.end > end) {
+                    r.base = end;
+                } else {
+                    r.end = r.base; // fully covered, dropped below
+                }
+            }
+
+            uint32_t out = 0;
+            for (uint32_t i = 0; i < count; ++i) {
+                if (ranges[i].end > ranges[i].base) ranges[out++] = ranges[i];
+            }
+            count = out;
+        }
+
+        // Lowest base among ranges overlapping [base, end); false if none does
+        inline bool first_overlap(uint64_t base, uint64_t end, uint64_t& hit) const {
+            for (uint32_t i = 0; i < count; ++i) {
+                if (ranges[i].base >= end) break;
+                if (ranges[i].end > base) { hit = ranges[i].base; return true; }
+            }
+            return false;
+        }
+    };
+
+    inline range_list_t memory;     // usable RAM, page aligned, reserved mmap entries carved out
+    inline range_list_t reserved;   // in use before the page allocator takes over
+    inline bool active = false;     // cleared once pfa has inherited the lists
+
+    // false when the reservation could not be recorded
+    inline bool reserve(uint64_t base, uint64_t end) {
+        return reserved.add(base & ~(PAGE - 1), (end + PAGE - 1) & ~(PAGE - 1));
+    }
+
+    // Allocate size bytes below limit, top-down, so low memory stays free for devices.
+    // Returns a physical address or 0.
+    inline uint64_t alloc(uint64_t size, uint64_t align = PAGE, uint64_t limit = UINT64_MAX) {
+        if (!active || !size) return 0;
+        if (align < PAGE) align = PAGE;
+        size = (size + PAGE - 1) & ~(PAGE - 1);
+
+        for (uint32_t i = memory.count; i-- > 0;) {
+            uint64_t lo = memory.ranges[i].base;
+            uint64_t hi = memory.ranges[i].end < limit ? memory.ranges[i].end : limit;
+            if (hi <= lo || hi - lo < size) continue;
+
+            uint64_t cand = (hi - size) & ~(align - 1);
+            while (cand >= lo) {
+                uint64_t hit;
+                if (!reserved.first_overlap(cand, cand + size, hit)) {
+                    // an unrecorded range would be handed out again and later freed to pfa
+                    return reserved.add(cand, cand + size) ? cand : 0;
+                }
+                if (hit < size) break;
+                cand = (hit - size) & ~(align - 1);
+            }
+        }
+        return 0;
+    }
+
+    // Build both lists from the boot information
+    inline void init(const feron::boot::mb2::info_t& info) {
+        memory.count = 0;
+        reserved.count = 0;
+
+        if (info.mmap && info.mmap_count > 0) {
+            // usable entries may come unsorted and overlapping; only whole pages count
+            for (uint32_t i = 0; i < info.mmap_count; ++i) {
+                auto e = info.mmap[i];
+                if (e.type != 1 || !e.len) continue;
+                memory.add((e.addr + PAGE - 1) & ~(PAGE - 1), (e.addr + e.len) & ~(PAGE - 1));
+            }
+            // reserved entries always win over usable ones
+            for (uint32_t i = 0; i < info.mmap_count; ++i) {
+                auto e = info.mmap[i];
+                if (e.type == 1 || !e.len) continue;
+                memory.remove(e.addr & ~(PAGE - 1), (e.addr + e.len + PAGE - 1) & ~(PAGE - 1));
+            }
+        }
+
+        // Skip the first page for safety
+        reserve(0, PAGE);
+
+        // Kernel image (includes the boot page tables and boot stack), boot information and modules.
+        // The boot information is parsed through the direct map.
+        reserve(reinterpret_cast<uint64_t>(__kernel_phys_start), reinterpret_cast<uint64_t>(__kernel_phys_end));
+        if (info.mbi_addr) {
+            uint64_t mbi_pa = direct_to_phys(reinterpret_cast<const void*>(info.mbi_addr));
+            reserve(mbi_pa, mbi_pa + info.mbi_size);
+        }
+        feron::boot::mb2::for_each_module(info, [](uint64_t start, uint64_t end){ reserve(start, end); });
+
+        // Reserve VGA text page
+        reserve(0xB8000ull, 0xB8000ull + PAGE);
+
+        active = true;
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+namespace feron::mm {
+    // Page flags
+    constexpr uint16_t PG_RESERVED = 1u << 0;   // never handed out (firmware, kernel image, boot data)
+    constexpr uint16_t PG_TABLE    = 1u << 1;   // holds a page table
+    constexpr uint16_t PG_SLAB     = 1u << 2;   // backs heap/slab objects
+    constexpr uint16_t PG_CACHE    = 1u << 3;   // cached file or device data
+    constexpr uint16_t PG_HEAD     = 1u << 4;   // first frame of a 2^order block
+    constexpr uint16_t PG_VMALLOC  = 1u << 5;   // first frame of a vmalloc area (owner = page count)
+    constexpr uint16_t PG_KMEM     = 1u << 6;   // part of a kmem_cache slab (owner = the cache)
+
+    // Per-frame descriptor; four share a cache line
+    struct page_t {
+        uint32_t refcount;   // 0 = free
+        uint16_t flags;
+        uint8_t  zone;
+        uint8_t  order;      // block order when PG_HEAD is set
+        uint64_t owner;      // opaque back-pointer for whoever holds the frame (cache, address space...)
+    };
+
+    static_assert(sizeof(page_t) == 16, "page_t must stay 16 bytes");
+}
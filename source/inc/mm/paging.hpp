@@ -1,212 +1,485 @@
 #pragma once
 
 #include <cstdint>
+#include "../cpu/cpuid.hpp"
+#include "../cpu/msr.hpp"
+#include "config.hpp"
+#include "hhdm.hpp"
 #include "pfa.hpp"
 #include "valloc.hpp"
+#include "zeropool.hpp"
+
+// Linker-provided kernel section bounds, page aligned
+extern "C" char __text_start[], __text_end[];
+extern "C" char __rodata_start[], __rodata_end[];
+extern "C" char __data_start[], __data_end[];
 
 namespace feron::mm::paging {
     constexpr uint64_t P_PRESENT  = 1ull << 0;
     constexpr uint64_t P_RW       = 1ull << 1;
     constexpr uint64_t P_USER     = 1ull << 2;
     constexpr uint64_t P_PS       = 1ull << 7;
+    constexpr uint64_t P_GLOBAL   = 1ull << 8;    // survives CR3 switches (kernel half only)
+    constexpr uint64_t P_COW      = 1ull << 9;    // software bit: read-only share, copy on write
     constexpr uint64_t P_NX       = 1ull << 63;
 
-    inline uint64_t* PML4_va = nullptr;  // VA of root (mapped)
-    inline uint64_t  PML4_pa = 0;        // physical address loaded into CR3
+    constexpr uint64_t P_PAT      = 1ull << 7;    // PAT bit of a 4 KiB PTE (same position as P_PS)
+    constexpr uint64_t P_PAT_HUGE = 1ull << 12;   // PAT bit of a 2 MiB / 1 GiB leaf
 
-    inline void invlpg(uint64_t va) { asm volatile("invlpg (%0)" : : "r"(va) : "memory"); }
+    constexpr uint64_t P_ADDR     = 0x000FFFFFFFFFF000ull;   // physical address bits of an entry
 
-    // Scratch helpers MUST be declared before any use
-    inline uint64_t scratch_va = 0;
+    // Levels: 1 = PT (4 KiB leaves), 2 = PD (2 MiB), 3 = PDPT (1 GiB), 4 = PML4
+    constexpr uint64_t SIZE_4K = 1ull << 12;
+    constexpr uint64_t SIZE_2M = 1ull << 21;
+    constexpr uint64_t SIZE_1G = 1ull << 30;
 
-    inline void* scratch_ptr() {
-        return reinterpret_cast<void*>(scratch_va);
-    }
+    inline uint64_t* PML4_va = nullptr;  // root of the active address space (in the direct map)
+    inline uint64_t  PML4_pa = 0;        // the kernel's own root
+    inline bool      huge_1g = false;    // CPU supports 1 GiB leaves
+    inline bool      pge = false;        // CR4.PGE set: kernel-half leaves are global
+    inline bool      pcid = false;       // CR4.PCIDE set: CR3 carries an address-space tag
+    inline bool      nx = false;         // EFER.NXE set: P_NX is honoured (otherwise it is stripped)
 
-    inline void unmap_scratch() {
-        if (!PML4_va || scratch_va == 0) return;
+    constexpr uint64_t CR0_WP    = 1ull << 16;   // supervisor writes obey read-only leaves
+    constexpr uint64_t CR4_PGE   = 1ull << 7;
+    constexpr uint64_t CR4_PCIDE = 1ull << 17;
+    constexpr uint64_t CR3_NOFLUSH = 1ull << 63;   // keep the new PCID's TLB entries on a CR3 write
 
-        auto idx = [](uint64_t v, int s){ return (v >> s) & 0x1FF; };
-        int i4 = idx(scratch_va, 39), i3 = idx(scratch_va, 30), i2 = idx(scratch_va, 21), i1 = idx(scratch_va, 12);
+    inline uint64_t read_cr4() { uint64_t v; asm volatile("mov %%cr4, %0" : "=r"(v)); return v; }
+    inline void write_cr4(uint64_t v) { asm volatile("mov %0, %%cr4" : : "r"(v) : "memory"); }
 
-        // Walk to the PT that contains scratch_va and clear the leaf
-        uint64_t pml4e = PML4_va[i4];
-        if (!(pml4e & P_PRESENT)) return;
-        uint64_t pdpt_pa = (pml4e & ~0xFFFull);
+    // invlpg also drops global entries for va, whatever PCID they were cached under
+    inline void invlpg(uint64_t va) { asm volatile("invlpg (%0)" : : "r"(va) : "memory"); }
 
-        // Map PDPT page into scratch to read its entry
-        if (!scratch_va) return;
-        // We re-use map_scratch once available; if it fails, just return quietly
-        extern bool map_scratch(uint64_t pa, uint64_t flags);
-        if (!map_scratch(pdpt_pa, P_PRESENT | P_RW)) return;
-        auto PDPT = reinterpret_cast<uint64_t*>(scratch_ptr());
-        uint64_t pdpte = PDPT[i3];
-        uint64_t pd_pa = (pdpte & P_PRESENT) ? (pdpte & ~0xFFFull) : 0;
-        // Clear scratch mapping of PDPT
-        // We can simply proceed; scratch leaf will be overwritten below.
+    // Reload CR3: non-global entries of the current PCID
+    inline void flush_all() {
+        uint64_t cr3;
+        asm volatile("mov %%cr3, %0\n\tmov %0, %%cr3" : "=r"(cr3) : : "memory");
+    }
 
-        if (!pd_pa) return;
-        if (!map_scratch(pd_pa, P_PRESENT | P_RW)) return;
-        auto PD = reinterpret_cast<uint64_t*>(scratch_ptr());
-        uint64_t pde = PD[i2];
-        uint64_t pt_pa = (pde & P_PRESENT) ? (pde & ~0xFFFull) : 0;
+    // Toggle CR4.PGE: every entry, global ones and every PCID included
+    inline void flush_global() {
+        if (!pge) { flush_all(); return; }
+        uint64_t cr4 = read_cr4();
+        write_cr4(cr4 & ~CR4_PGE);
+        write_cr4(cr4);
+    }
 
-        if (!pt_pa) return;
-        if (!map_scratch(pt_pa, P_PRESENT | P_RW)) return;
-        auto PT = reinterpret_cast<uint64_t*>(scratch_ptr());
-        PT[i1] = 0;
-        invlpg(scratch_va);
+    // After a table was unlinked: with PCIDs, other tags may still cache paths through it
+    inline void flush_table_caches(uint64_t va) {
+        if (pcid) flush_global();
+        else invlpg(va);
     }
 
-    // Forward declare walk_create before map_page uses it
-    uint64_t* walk_create(uint64_t va);
+    inline uint64_t nx_bit() { return nx ? P_NX : 0; }
 
-    inline bool map_page(uint64_t va, uint64_t pa, uint64_t flags = P_PRESENT | P_RW) {
-        uint64_t* pte = walk_create(va);
-        if (!pte) return false;
-        *pte = (pa & ~0xFFFull) | (flags & ~P_PS);
-        invlpg(va);
-        return true;
+    // Kernel-half leaves are global once PGE is on; P_NX is a reserved bit without EFER.NXE
+    inline uint64_t leaf_flags_for(uint64_t va, uint64_t flags) {
+        if (!nx) flags &= ~P_NX;
+        return (pge && (va >> 63)) ? flags | P_GLOBAL : flags;
     }
 
-    // Map a physical page at scratch_va so we can write its contents
-    inline bool map_scratch(uint64_t pa, uint64_t flags = P_PRESENT | P_RW) {
-        if (scratch_va == 0) {
-            scratch_va = feron::mm::valloc::alloc_range(feron::mm::pfa::PAGE_SIZE);
-            if (scratch_va == 0) return false;
-        }
-        if (!PML4_va) {
-            // Pre-CR3 path: we cannot create a mapping via walk_create yet.
-            // Callers should only use scratch pre-CR3 for physical writes after identity is set.
-            return false;
-        }
-        return map_page(scratch_va, pa, flags);
+    inline uint64_t level_shift(int level) { return 12 + 9 * static_cast<uint64_t>(level - 1); }
+    inline uint64_t level_size(int level) { return 1ull << level_shift(level); }
+    inline uint64_t idx(uint64_t va, int level) { return (va >> level_shift(level)) & 0x1FF; }
+
+    // Table an entry points to, through the direct map
+    inline uint64_t* table_at(uint64_t entry) {
+        return feron::mm::phys_to_virt<uint64_t>(entry & P_ADDR);
     }
 
-    // Allocate and zero a page table using scratch map (post-CR3)
+    // Allocate a zeroed page table
     inline uint64_t alloc_table_pa() {
-        uint64_t pa = feron::mm::pfa::alloc_page();
-        if (!pa) return 0;
-        if (!map_scratch(pa)) return 0;
-        memset(scratch_ptr(), 0, feron::mm::pfa::PAGE_SIZE);
-        unmap_scratch();
+        uint64_t pa = feron::mm::zeropool::alloc_zeroed_page();
+        if (auto* pg = feron::mm::pfa::page_of(pa)) pg->flags |= PG_TABLE;
         return pa;
     }
 
-    // Walk tables; table contents are modified through scratch mappings
-    inline uint64_t* walk_create(uint64_t va) {
-        auto idx = [](uint64_t v, int s){ return (v >> s) & 0x1FF; };
-        int i4 = idx(va, 39), i3 = idx(va, 30), i2 = idx(va, 21), i1 = idx(va, 12);
+    inline void free_table(uint64_t pa) {
+        if (auto* pg = feron::mm::pfa::page_of(pa)) pg->flags &= static_cast<uint16_t>(~PG_TABLE);
+        feron::mm::pfa::free_page(pa);
+    }
+
+    // Leaf entry for pa at level; a 4 KiB leaf never carries P_PS, a huge one always does
+    inline uint64_t leaf_entry(uint64_t pa, uint64_t flags, int level) {
+        if (level == 1) return (pa & P_ADDR) | (flags & ~(P_ADDR | P_PS));
+        return (pa & P_ADDR & ~(level_size(level) - 1)) | (flags & ~P_ADDR) | P_PS;
+    }
+
+    // Replace the huge leaf in entry (level 2 or 3) with a table of next-level leaves
+    // mapping the same range with the same attributes; returns the new table
+    inline uint64_t* split_leaf(uint64_t& entry, int level) {
+        uint64_t table_pa = alloc_table_pa();
+        if (!table_pa) return nullptr;
+        uint64_t* t = feron::mm::phys_to_virt<uint64_t>(table_pa);
+
+        uint64_t base  = entry & P_ADDR & ~(level_size(level) - 1);
+        uint64_t attrs = entry & ~P_ADDR;
+        uint64_t pat   = entry & P_PAT_HUGE;
 
-        if (!PML4_va) return nullptr;
+        // 2 MiB children keep P_PS and the huge PAT bit; 4 KiB children move PAT to bit 7
+        uint64_t child_attrs = (level == 2) ? ((attrs & ~P_PS) | (pat ? P_PAT : 0)) : (attrs | pat);
+        uint64_t step = level_size(level - 1);
+        for (uint64_t i = 0; i < 512; ++i) t[i] = (base + i * step) | child_attrs;
 
-        // PDPT
-        uint64_t pml4e = PML4_va[i4];
-        uint64_t pdpt_pa = (pml4e & P_PRESENT) ? (pml4e & ~0xFFFull) : 0;
-        if (!pdpt_pa) {
-            pdpt_pa = alloc_table_pa();
-            if (!pdpt_pa) return nullptr;
-            PML4_va[i4] = (pdpt_pa & ~0xFFFull) | P_PRESENT | P_RW;
+        entry = table_pa | P_PRESENT | P_RW | (attrs & P_USER);
+        return t;
+    }
+
+    // Entry that maps va at level under root, creating missing tables and splitting larger
+    // leaves on the way. user (P_USER or 0) is added to every table entry on the path.
+    inline uint64_t* walk_to(uint64_t* root, uint64_t va, int level, uint64_t user = 0) {
+        if (!root) return nullptr;
+        uint64_t* table = root;
+        for (int l = 4; l > level; --l) {
+            uint64_t& e = table[idx(va, l)];
+            if (!(e & P_PRESENT)) {
+                uint64_t pa = alloc_table_pa();
+                if (!pa) return nullptr;
+                e = pa | P_PRESENT | P_RW | user;
+                table = table_at(e);
+            } else if (e & P_PS) {
+                table = split_leaf(e, l);
+                if (!table) return nullptr;
+                e |= user;
+                invlpg(va);
+            } else {
+                e |= user;
+                table = table_at(e);
+            }
         }
+        return &table[idx(va, level)];
+    }
 
-        // Touch PDPT via scratch
-        if (!map_scratch(pdpt_pa)) return nullptr;
-        auto PDPT = reinterpret_cast<uint64_t*>(scratch_ptr());
-        uint64_t pdpte = PDPT[i3];
-        uint64_t pd_pa = (pdpte & P_PRESENT) ? (pdpte & ~0xFFFull) : 0;
-        if (!pd_pa) {
-            pd_pa = alloc_table_pa();
-            if (!pd_pa) { unmap_scratch(); return nullptr; }
-            PDPT[i3] = (pd_pa & ~0xFFFull) | P_PRESENT | P_RW;
+    inline uint64_t* walk_to(uint64_t va, int level) { return walk_to(PML4_va, va, level); }
+
+    // Entry that maps va at level without changing anything; nullptr when a level above
+    // is missing or is itself a leaf
+    inline uint64_t* lookup(uint64_t* root, uint64_t va, int level) {
+        if (!root) return nullptr;
+        uint64_t* table = root;
+        for (int l = 4; l > level; --l) {
+            uint64_t e = table[idx(va, l)];
+            if (!(e & P_PRESENT) || (e & P_PS)) return nullptr;
+            table = table_at(e);
         }
-        unmap_scratch();
+        return &table[idx(va, level)];
+    }
 
-        // PD
-        if (!map_scratch(pd_pa)) return nullptr;
-        auto PD = reinterpret_cast<uint64_t*>(scratch_ptr());
-        uint64_t pde = PD[i2];
-        uint64_t pt_pa = (pde & P_PRESENT) ? (pde & ~0xFFFull) : 0;
-        if (!pt_pa) {
-            pt_pa = alloc_table_pa();
-            if (!pt_pa) { unmap_scratch(); return nullptr; }
-            PD[i2] = (pt_pa & ~0xFFFull) | P_PRESENT | P_RW;
+    inline uint64_t* lookup(uint64_t va, int level) { return lookup(PML4_va, va, level); }
+
+    // Leaf PTE for va, creating intermediate tables as needed
+    inline uint64_t* walk_create(uint64_t va) { return walk_to(va, 1); }
+
+    // Collapse the table under entry (level 2 or 3) into one huge leaf when its 512 entries
+    // are leaves of one contiguous, aligned physical range with identical attributes.
+    // va is any address inside the range.
+    inline bool try_promote(uint64_t& entry, int level, uint64_t va) {
+        if (!(entry & P_PRESENT) || (entry & P_PS)) return false;
+        if (level == 3 && !huge_1g) return false;
+
+        const uint64_t* t = table_at(entry);
+        uint64_t first = t[0];
+        if (!(first & P_PRESENT)) return false;
+        if (level == 3 && !(first & P_PS)) return false;   // children must be 2 MiB leaves
+        uint64_t base = first & P_ADDR & (level == 3 ? ~P_PAT_HUGE : ~0ull);
+        if (base & (level_size(level) - 1)) return false;
+
+        // same attributes and consecutive frames: every entry is the first one plus i steps
+        uint64_t step = level_size(level - 1);
+        for (uint64_t i = 1; i < 512; ++i) {
+            if (t[i] != first + i * step) return false;
         }
-        unmap_scratch();
 
-        // PT
-        if (!map_scratch(pt_pa)) return nullptr;
-        auto PT = reinterpret_cast<uint64_t*>(scratch_ptr());
-        uint64_t* leaf = &PT[i1];
-        return leaf;
+        uint64_t leaf = first;
+        if (level == 2) {
+            uint64_t attrs = first & ~P_ADDR;
+            leaf = (first & P_ADDR) | (attrs & ~P_PAT) | P_PS | ((attrs & P_PAT) ? P_PAT_HUGE : 0);
+        }
+
+        uint64_t table_pa = entry & P_ADDR;
+        entry = leaf;
+        // drops the paging-structure caches that still point at the old table
+        flush_table_caches(va);
+        free_table(table_pa);
+        return true;
     }
 
-    // Initialize paging with safe 4 MiB identity before CR3 switch
-    inline void init(uint64_t va_pool_base, uint64_t va_pool_size,
-                     uint64_t initial_map_va = 0, uint64_t initial_map_pa = 0, uint64_t initial_map_size = 0,
-                     uint64_t leaf_flags = P_PRESENT | P_RW) {
-        feron::mm::valloc::init(va_pool_base, va_pool_size);
+    // Promote every fully populated table backing [start, end)
+    inline void promote_range(uint64_t start, uint64_t end) {
+        for (uint64_t b = start & ~(SIZE_2M - 1); b < end; b += SIZE_2M) {
+            if (uint64_t* pde = lookup(b, 2)) try_promote(*pde, 2, b);
+        }
+        if (!huge_1g) return;
+        for (uint64_t b = start & ~(SIZE_1G - 1); b < end; b += SIZE_1G) {
+            if (uint64_t* pdpte = lookup(b, 3)) try_promote(*pdpte, 3, b);
+        }
+    }
 
-        // Create tables physically and zero via current identity (from trampoline)
-        auto memzero_phys = [](uint64_t pa){
-            volatile uint8_t* p = reinterpret_cast<volatile uint8_t*>(pa);
-            for (std::size_t i = 0; i < feron::mm::pfa::PAGE_SIZE; ++i) p[i] = 0;
-        };
+    // Edits go through the active tables only: the flush below is only right for them, and an
+    // inactive address space has to be marked stale by aspace, which paging cannot reach
+    inline bool map_page(uint64_t va, uint64_t pa, uint64_t flags = P_PRESENT | P_RW) {
+        uint64_t* pte = walk_to(PML4_va, va, 1, flags & P_USER);
+        if (!pte) return false;
+        bool was_present = *pte & P_PRESENT;
+        *pte = leaf_entry(pa, leaf_flags_for(va, flags), 1);
+        // not-present entries are never cached, so a fresh mapping needs no flush
+        if (was_present) invlpg(va);
+        return true;
+    }
 
-        PML4_pa = feron::mm::pfa::alloc_page();
-        uint64_t pdpt_pa = feron::mm::pfa::alloc_page();
-        uint64_t pd_pa   = feron::mm::pfa::alloc_page();
-        uint64_t pt_pa   = feron::mm::pfa::alloc_page();
-        if (!PML4_pa || !pdpt_pa || !pd_pa || !pt_pa) return;
+    // Largest leaf level whose size and alignment fit va, pa and the remaining length
+    inline int leaf_level(uint64_t va, uint64_t pa, uint64_t remaining) {
+        for (int l = huge_1g ? 3 : 2; l > 1; --l) {
+            uint64_t sz = level_size(l);
+            if (!((va | pa) & (sz - 1)) && remaining >= sz) return l;
+        }
+        return 1;
+    }
 
-        memzero_phys(PML4_pa);
-        memzero_phys(pdpt_pa);
-        memzero_phys(pd_pa);
-        memzero_phys(pt_pa);
+    // Map a range dynamically (size multiple of page size), with 1 GiB / 2 MiB leaves
+    // wherever va, pa and the remaining size line up
+    inline bool map_range(uint64_t va, uint64_t pa, uint64_t size, uint64_t flags) {
+        const uint64_t start = va, end = va + size;
+        while (va < end) {
+            int level = leaf_level(va, pa, end - va);
+            uint64_t* e = walk_to(PML4_va, va, level, flags & P_USER);
 
-        // Wire PML4[0] -> PDPT, PDPT[0] -> PD, PD[0] -> PT
-        volatile uint64_t* PML4phys = reinterpret_cast<volatile uint64_t*>(PML4_pa);
-        volatile uint64_t* PDPTphys = reinterpret_cast<volatile uint64_t*>(pdpt_pa);
-        volatile uint64_t* PDphys   = reinterpret_cast<volatile uint64_t*>(pd_pa);
-        volatile uint64_t* PTphys   = reinterpret_cast<volatile uint64_t*>(pt_pa);
+            // an existing table stays; fill it at the next level down and let promotion merge it
+            while (e && level > 1 && (*e & P_PRESENT) && !(*e & P_PS)) e = walk_to(PML4_va, va, --level, flags & P_USER);
+            if (!e) return false;
 
-        PML4phys[0] = (pdpt_pa & ~0xFFFull) | P_PRESENT | P_RW;
-        PDPTphys[0] = (pd_pa   & ~0xFFFull) | P_PRESENT | P_RW;
-        PDphys[0]   = (pt_pa   & ~0xFFFull) | P_PRESENT | P_RW;
+            bool was_present = *e & P_PRESENT;
+            *e = leaf_entry(pa, leaf_flags_for(va, flags), level);
+            if (was_present) invlpg(va);
 
-        // Identity map 0..4 MiB (4 KiB pages)
-        for (uint64_t off = 0, i = 0; i < 1024; ++i, off += feron::mm::pfa::PAGE_SIZE) {
-            PTphys[i] = (off & ~0xFFFull) | leaf_flags;
+            va += level_size(level);
+            pa += level_size(level);
         }
+        promote_range(start, end);
+        return true;
+    }
 
-        // Load CR3 to the new PML4
-        asm volatile("mov %0, %%cr3" : : "r"(PML4_pa) : "memory");
+    // Translate va through the live tables (returns physical address or 0 when unmapped)
+    inline uint64_t virt_to_phys(const uint64_t* root, uint64_t va) {
+        if (!root) return 0;
+        const uint64_t* table = root;
+        for (int l = 4; l >= 1; --l) {
+            uint64_t e = table[idx(va, l)];
+            if (!(e & P_PRESENT)) return 0;
+            if (l == 1 || (e & P_PS)) {
+                uint64_t mask = level_size(l) - 1;
+                return (e & P_ADDR & ~mask) + (va & mask);
+            }
+            table = table_at(e);
+        }
+        return 0;
+    }
 
-        // Permanently map PML4 into VA space and set PML4_va
-        uint64_t pml4_va_page = feron::mm::valloc::alloc_range(feron::mm::pfa::PAGE_SIZE);
-        if (pml4_va_page == 0) return;
+    inline uint64_t virt_to_phys(uint64_t va) { return virt_to_phys(PML4_va, va); }
+
+    // Bits protect_range may change; caching attributes and the frame stay as they are
+    constexpr uint64_t PROT_BITS = P_PRESENT | P_RW | P_USER | P_NX;
+
+    // Beyond this many invalidations a CR3 reload is cheaper than invlpg one by one
+    constexpr uint32_t FLUSH_MAX = 32;
+
+    // Invalidations gathered over one unmap/protect call. Emptied tables are only freed
+    // once the flush has run, so no paging-structure cache can still point at them.
+    struct flush_batch_t {
+        uint64_t va[FLUSH_MAX];
+        uint32_t count = 0;
+        bool all = false;
+        bool kernel = false;   // a kernel-half (global) address is involved
+        uint64_t tables[FLUSH_MAX];
+        uint32_t table_count = 0;
+        bool failed = false;
+
+        void add(uint64_t v) {
+            if (v >> 63) kernel = true;
+            if (all) return;
+            if (count == FLUSH_MAX) { all = true; return; }
+            va[count++] = v;
+        }
 
-        // Use identity PT to map PML4_pa at pml4_va_page
-        uint64_t slot = (pml4_va_page >> 12) & 0x3FF;
-        PTphys[slot] = (PML4_pa & ~0xFFFull) | P_PRESENT | P_RW;
-        PML4_va = reinterpret_cast<uint64_t*>(pml4_va_page);
+        void finish() {
+            // with PCIDs, a freed table may still be cached under another tag
+            bool tables_shared = pcid && table_count;
+            if (all || tables_shared) {
+                if (kernel || tables_shared) flush_global();
+                else flush_all();
+            } else {
+                for (uint32_t i = 0; i < count; ++i) invlpg(va[i]);
+            }
+            for (uint32_t i = 0; i < table_count; ++i) free_table(tables[i]);
+            count = table_count = 0;
+            all = kernel = false;
+        }
 
-        // Optional initial map
-        if (initial_map_size) {
-            uint64_t va = initial_map_va;
-            uint64_t pa = initial_map_pa;
-            uint64_t end = pa + initial_map_size;
-            for (; pa < end; pa += feron::mm::pfa::PAGE_SIZE, va += feron::mm::pfa::PAGE_SIZE) {
-                map_page(va, pa, leaf_flags);
+        void free_table_later(uint64_t pa, uint64_t v) {
+            if (table_count == FLUSH_MAX) finish();
+            tables[table_count++] = pa;
+            add(v);
+        }
+    };
+
+    // Unmap (or re-protect with prot) every leaf covering [va, end) below table, which sits at level.
+    // Huge leaves only partly covered are split first. Returns true when the table ends up empty.
+    inline bool apply_range(uint64_t* table, int level, uint64_t va, uint64_t end,
+                            bool unmap, uint64_t prot, flush_batch_t& fb) {
+        const uint64_t size = level_size(level);
+        bool cleared = false;
+        for (uint64_t cur = va; cur < end;) {
+            uint64_t next = (cur & ~(size - 1)) + size;
+            uint64_t stop = (next == 0 || next > end) ? end : next;   // next wraps at the top of the address space
+            uint64_t& e = table[idx(cur, level)];
+
+            if (e & P_PRESENT) {
+                bool leaf = level == 1 || (e & P_PS);
+                if (leaf && stop - cur != size) {
+                    if (!split_leaf(e, level)) { fb.failed = true; return false; }
+                    fb.add(cur);
+                    leaf = false;
+                }
+
+                if (leaf && unmap) {
+                    e = 0;
+                    cleared = true;
+                    fb.add(cur);
+                } else if (leaf) {
+                    uint64_t n = (e & ~PROT_BITS) | (prot & PROT_BITS);
+                    if (n != e) { e = n; fb.add(cur); }
+                } else if (apply_range(table_at(e), level - 1, cur, stop, unmap, prot, fb) && level <= 3) {
+                    // PDPTs stay even when empty: PML4 slots are what address spaces share
+                    uint64_t child_pa = e & P_ADDR;
+                    e = 0;
+                    cleared = true;
+                    fb.free_table_later(child_pa, cur);
+                }
+                if (fb.failed) return false;
             }
+            cur = stop;
         }
+
+        if (!cleared) return false;
+        for (uint64_t i = 0; i < 512; ++i) {
+            if (table[i] & P_PRESENT) return false;
+        }
+        return true;
     }
 
-    // Map a range dynamically (size multiple of page size)
-    inline bool map_range(uint64_t va, uint64_t pa, uint64_t size, uint64_t flags) {
-        uint64_t end = pa + size;
-        for (; pa < end; pa += feron::mm::pfa::PAGE_SIZE, va += feron::mm::pfa::PAGE_SIZE) {
-            if (!map_page(va, pa, flags)) return false;
+    // Remove every mapping in [va, va + size) of the active tables and give emptied page
+    // tables back to pfa. The frames that were mapped are left to the caller.
+    inline bool unmap_range(uint64_t va, uint64_t size) {
+        if (!PML4_va || !size) return false;
+        flush_batch_t fb;
+        apply_range(PML4_va, 4, va, va + size, true, 0, fb);
+        fb.finish();
+        return !fb.failed;
+    }
+
+    // Change the permission bits (PROT_BITS) of every mapping in [va, va + size)
+    inline bool protect_range(uint64_t va, uint64_t size, uint64_t flags) {
+        if (!PML4_va || !size) return false;
+        if (!nx) flags &= ~P_NX;
+        flush_batch_t fb;
+        apply_range(PML4_va, 4, va, va + size, false, flags, fb);
+        fb.finish();
+        // splits made for a partial change may now be uniform again
+        promote_range(va, va + size);
+        return !fb.failed;
+    }
+
+    // Map the kernel image at its link address, section by section, each with only the rights
+    // it needs (W^X): text RX (global), rodata R+NX, data/bss RW+NX. map_range uses 2 MiB leaves
+    // wherever a section's span allows and promotion merges whatever ends up uniform.
+    inline bool map_kernel_sections() {
+        struct section_t { const char* start; const char* end; uint64_t flags; };
+        const section_t sections[] = {
+            { __text_start,   __text_end,   P_PRESENT | (pge ? P_GLOBAL : 0) },
+            { __rodata_start, __rodata_end, P_PRESENT | P_NX },
+            { __data_start,   __data_end,   P_PRESENT | P_RW | P_NX },
+        };
+        for (const auto& sec : sections) {
+            uint64_t start = reinterpret_cast<uint64_t>(sec.start);
+            uint64_t end = reinterpret_cast<uint64_t>(sec.end);
+            if (end > start && !map_range(start, feron::mm::image_to_phys(sec.start), end - start, sec.flags)) return false;
         }
         return true;
     }
+
+    // Build the kernel's own tables: a direct map of all RAM plus the kernel image at -2 GiB, then
+    // switch CR3. The trampoline's identity window is not carried over, so the lower half is empty.
+    inline void init(uint64_t va_pool_base, uint64_t va_pool_size,
+                     uint64_t initial_map_va = 0, uint64_t initial_map_pa = 0, uint64_t initial_map_size = 0,
+                     uint64_t leaf_flags = P_PRESENT | P_RW) {
+        feron::mm::valloc::init(va_pool_base, va_pool_size);
+
+        // Tables are written through the trampoline's direct map, which covers the low 4 GiB;
+        // the zeroed-page pool hands out low frames until the full map is live
+        PML4_pa = alloc_table_pa();
+        if (!PML4_pa) return;
+        uint64_t* pml4 = feron::mm::phys_to_virt<uint64_t>(PML4_pa);
+
+        // Cover all RAM, and at least the low 4 GiB (boot data, legacy MMIO), in whole GiB
+        uint64_t top = 4ull << 30;
+        if (feron::mm::pfa::region_count) {
+            uint64_t ram_end = feron::mm::pfa::regions[feron::mm::pfa::region_count - 1].end();
+            if (ram_end > top) top = ram_end;
+        }
+        uint64_t gibs = (top + SIZE_1G - 1) >> 30;
+
+        // The direct map may use PML4 slots up to the dynamic VA pool
+        const uint64_t first_slot = idx(feron::mm::config::hhdm_base, 4);
+        const uint64_t max_gibs = (idx(va_pool_base, 4) - first_slot) * 512;
+        if (gibs > max_gibs) gibs = max_gibs;
+
+        // Walks only touch memory, so the new tables can be filled before they are live;
+        // map_range picks 1 GiB leaves when the CPU has them, 2 MiB otherwise.
+        // Kernel-half leaves get P_GLOBAL from the start when the CPU can honour it.
+        huge_1g = feron::cpu::cpuid::has_1g_pages();
+        pge = feron::cpu::cpuid::has_pge();
+
+        // The live trampoline tables never set P_NX, so NXE can go on before the switch
+        nx = feron::cpu::cpuid::has_nx();
+        if (nx) feron::cpu::msr::write(feron::cpu::msr::IA32_EFER, feron::cpu::msr::read(feron::cpu::msr::IA32_EFER) | feron::cpu::msr::EFER_NXE);
+
+        // The direct map is data only, and its alias of kernel text and rodata is read-only
+        PML4_va = pml4;
+        if (!map_range(feron::mm::config::hhdm_base, 0, gibs << 30, leaf_flags | P_NX)) { PML4_va = nullptr; return; }
+        uint64_t image_ro = feron::mm::image_to_phys(__text_start);
+        protect_range(image_ro + feron::mm::config::hhdm_base, feron::mm::image_to_phys(__rodata_end) - image_ro, P_PRESENT | P_NX);
+
+        // Every kernel-half PDPT exists from the start, so address spaces that copy the
+        // upper PML4 slots see all later kernel mappings too
+        for (uint64_t slot = 256; slot < 512; ++slot) {
+            if (pml4[slot] & P_PRESENT) continue;
+            uint64_t pa = alloc_table_pa();
+            if (!pa) { PML4_va = nullptr; return; }
+            pml4[slot] = pa | P_PRESENT | P_RW;
+        }
+
+        // Everything the kernel touches from here on is reached through the direct map or the image
+        if (!map_kernel_sections()) {
+            PML4_va = nullptr;
+            return;
+        }
+
+        // Load CR3 to the new PML4 (PCID 0 is the kernel's), then turn on global pages and PCIDs
+        asm volatile("mov %0, %%cr3" : : "r"(PML4_pa) : "memory");
+        uint64_t cr0;
+        asm volatile("mov %%cr0, %0" : "=r"(cr0));
+        asm volatile("mov %0, %%cr0" : : "r"(cr0 | CR0_WP) : "memory");
+        if (pge) write_cr4(read_cr4() | CR4_PGE);
+        if (pge && feron::cpu::cpuid::has_pcid()) {
+            write_cr4(read_cr4() | CR4_PCIDE);
+            pcid = true;
+        }
+
+        feron::mm::hhdm_size = gibs << 30;
+        feron::mm::zeropool::pool_zones = feron::mm::pfa::ZM_ANY;
+
+        // Optional initial map
+        if (initial_map_size) map_range(initial_map_va, initial_map_pa, initial_map_size, leaf_flags);
+    }
 }
@@ -1,116 +1,444 @@
 #pragma once
 
 #include <cstdint>
-#include "../runtime/impl/mm/malloc.hpp"
+#include "../cpu/context.hpp"
 #include "../runtime/impl/mem/set.hpp"
-#include "../boot/mb2.hpp"
+#include "../sync/spinlock.hpp"
+#include "buddy.hpp"
+#include "config.hpp"
+#include "hbitmap.hpp"
+#include "hhdm.hpp"
+#include "memblock.hpp"
+#include "page.hpp"
 
 namespace feron::mm::pfa {
     // 4 KiB pages
     constexpr std::size_t PAGE_SIZE = 4096;
 
-    // Simple global bitmap over all usable memory
-    inline uint64_t phys_base = 0;       // first usable physical address
-    inline uint64_t phys_limit = 0;      // end of usable range (exclusive)
-    inline uint64_t total_pages = 0;
-
-    inline uint8_t* bitmap = nullptr;    // points inside kernel heap
-    inline uint64_t bitmap_bytes = 0;
-
-    // Mark bit helpers
-    inline bool bit_get(uint64_t i) { return (bitmap[i >> 3] >> (i & 7)) & 1; }
-    inline void bit_set(uint64_t i) { bitmap[i >> 3] |=  (1u << (i & 7)); }
-    inline void bit_clear(uint64_t i){ bitmap[i >> 3] &= ~(1u << (i & 7)); }
-
-    // Returns page index for a physical address
-    inline uint64_t pa_to_index(uint64_t pa) { return (pa - phys_base) / PAGE_SIZE; }
-    inline uint64_t index_to_pa(uint64_t idx) { return phys_base + idx * PAGE_SIZE; }
-
-    // Initialize from Multiboot2 mmap: choose the lowest usable region as base and cover all usable as range.
-    // Allocate the bitmap from kernel heap.
-    inline void init(const feron::boot::mb2::info_t& info) {
-        uint64_t min_addr = UINT64_MAX, max_addr = 0;
-
-        // Collect global usable range
-        if (info.mmap && info.mmap_count > 0) {
-            for (uint32_t i = 0; i < info.mmap_count; ++i) {
-                auto e = info.mmap[i];
-                if (e.type == 1 && e.len) {
-                    if (e.addr < min_addr) min_addr = e.addr;
-                    if (e.addr + e.len > max_addr) max_addr = e.addr + e.len;
-                }
+    // One region per usable memblock range, plus one per zone boundary it crosses
+    constexpr uint32_t MAX_REGIONS = memblock::MAX_RANGES + 2;
+
+    // Physical zones, lowest first. A region never straddles a zone boundary.
+    enum zone_id : uint32_t { ZONE_DMA = 0, ZONE_DMA32 = 1, ZONE_NORMAL = 2, ZONE_COUNT = 3 };
+
+    // Zone masks for the allocation APIs
+    constexpr uint32_t ZM_DMA    = 1u << ZONE_DMA;      // ISA DMA: below 16 MiB
+    constexpr uint32_t ZM_DMA32  = 1u << ZONE_DMA32;    // 32-bit devices: below 4 GiB
+    constexpr uint32_t ZM_NORMAL = 1u << ZONE_NORMAL;   // everything else
+    constexpr uint32_t ZM_LOW    = ZM_DMA | ZM_DMA32;   // anything addressable with 32 bits
+    constexpr uint32_t ZM_ANY    = ZM_DMA | ZM_DMA32 | ZM_NORMAL;
+
+    constexpr uint64_t zone_limit[ZONE_COUNT] = { 16ull << 20, 4ull << 30, UINT64_MAX };
+
+    struct zone_t {
+        const char* name;
+        uint32_t first_region = 0;   // regions [first_region, first_region + region_count)
+        uint32_t region_count = 0;
+        uint32_t region_hint = 0;    // region the last allocation came from (absolute index)
+        uint64_t total_pages = 0;
+        uint64_t free_pages = 0;     // free pages in the zone's bitmaps
+    };
+
+    inline zone_t zones[ZONE_COUNT] = { { "DMA" }, { "DMA32" }, { "NORMAL" } };
+
+    inline uint32_t zone_of(uint64_t pa) {
+        return pa < zone_limit[ZONE_DMA] ? ZONE_DMA : pa < zone_limit[ZONE_DMA32] ? ZONE_DMA32 : ZONE_NORMAL;
+    }
+
+    // One contiguous run of usable RAM with its own compact bitmap and frame descriptors
+    struct region_t {
+        uint64_t base = 0;    // physical address of the first page
+        uint64_t pages = 0;
+        uint32_t zone = 0;
+        hbitmap_t map;        // bit i describes base + i * PAGE_SIZE
+        page_t* frames = nullptr;   // frames[i] describes base + i * PAGE_SIZE
+
+        uint64_t end() const { return base + pages * PAGE_SIZE; }
+    };
+
+    // Sorted by base, non-overlapping
+    inline region_t regions[MAX_REGIONS];
+    inline uint32_t region_count = 0;
+
+    inline uint64_t total_pages = 0;     // usable pages across all regions
+    inline uint64_t bitmap_bytes = 0;    // metadata footprint (carved out by memblock)
+    inline uint64_t frame_db_bytes = 0;  // of which page_t descriptors
+
+    // Binary search for the region containing pa; returns region_count if none does
+    inline uint32_t find_region(uint64_t pa) {
+        uint32_t lo = 0, hi = region_count;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (pa < regions[mid].base) hi = mid;
+            else if (pa >= regions[mid].end()) lo = mid + 1;
+            else return mid;
+        }
+        return region_count;
+    }
+
+    // Apply fn(region, sidx, eidx) to the page indices of every region that [start, end) touches
+    template <typename F>
+    inline void for_each_in_range(uint64_t start, uint64_t end, F&& fn) {
+        for (uint32_t r = 0; r < region_count; ++r) {
+            auto& reg = regions[r];
+            if (reg.base >= end) break;
+            if (reg.end() <= start) continue;
+            uint64_t s = start > reg.base ? start : reg.base;
+            uint64_t e = end < reg.end() ? end : reg.end();
+            fn(reg, (s - reg.base) / PAGE_SIZE, (e - reg.base + PAGE_SIZE - 1) / PAGE_SIZE);
+        }
+    }
+
+    // Descriptor of the frame containing pa, or nullptr outside usable RAM
+    inline page_t* page_of(uint64_t pa) {
+        uint32_t r = find_region(pa);
+        if (r == region_count) return nullptr;
+        return &regions[r].frames[(pa - regions[r].base) / PAGE_SIZE];
+    }
+
+    inline page_t* pfn_to_page(uint64_t pfn) { return page_of(pfn * PAGE_SIZE); }
+
+    // Mark every page touching [start, end) as used / free, a word at a time
+    inline void reserve_range(uint64_t start, uint64_t end) {
+        for_each_in_range(start, end, [](region_t& reg, uint64_t s, uint64_t e){
+            uint64_t before = reg.map.free;
+            reg.map.reserve_range(s, e);
+            zones[reg.zone].free_pages -= before - reg.map.free;
+        });
+    }
+
+    inline void release_range(uint64_t start, uint64_t end) {
+        for_each_in_range(start, end, [](region_t& reg, uint64_t s, uint64_t e){
+            uint64_t before = reg.map.free;
+            reg.map.release_range(s, e);
+            zones[reg.zone].free_pages += reg.map.free - before;
+        });
+    }
+
+    // Flag (or unflag) the descriptors of [start, end) as reserved; reserved frames hold one reference
+    inline void set_reserved(uint64_t start, uint64_t end, bool on) {
+        for_each_in_range(start, end, [on](region_t& reg, uint64_t s, uint64_t e){
+            for (uint64_t i = s; i < e; ++i) {
+                reg.frames[i].flags = on ? PG_RESERVED : 0;
+                reg.frames[i].refcount = on ? 1 : 0;
             }
+        });
+    }
+
+    // Initialize from the memblock lists: every usable range becomes a region, and
+    // every memblock reservation (including the metadata allocated here) stays used.
+    inline void init() {
+        total_pages = bitmap_bytes = 0;
+        region_count = 0;
+        for (auto& z : zones) { z.first_region = z.region_count = z.region_hint = 0; z.total_pages = z.free_pages = 0; }
+
+        // Split the usable ranges at zone boundaries so each region belongs to exactly one zone
+        for (uint32_t i = 0; i < memblock::memory.count && region_count < MAX_REGIONS; ++i) {
+            uint64_t base = memblock::memory.ranges[i].base, end = memblock::memory.ranges[i].end;
+            while (base < end && region_count < MAX_REGIONS) {
+                uint32_t z = zone_of(base);
+                uint64_t stop = end < zone_limit[z] ? end : zone_limit[z];
+                auto& reg = regions[region_count];
+                reg.base = base;
+                reg.pages = (stop - base) / PAGE_SIZE;
+                reg.zone = z;
+                if (!zones[z].region_count) zones[z].first_region = zones[z].region_hint = region_count;
+                ++zones[z].region_count;
+                zones[z].total_pages += reg.pages;
+                total_pages += reg.pages;
+                ++region_count;
+                base = stop;
+            }
+        }
+
+        // Buddy arena: a physically aligned run, taken top-down so low memory stays free.
+        // Tries the configured arena size first and halves it until something fits.
+        const uint64_t block_bytes = PAGE_SIZE << buddy::MAX_ORDER;
+        uint64_t arena_pa = 0, arena_size = feron::mm::config::buddy_arena_size & ~(block_bytes - 1);
+        for (; arena_size >= block_bytes; arena_size >>= 1) {
+            arena_pa = memblock::alloc(arena_size, block_bytes);
+            if (arena_pa) break;
         }
+        uint64_t arena_pages = arena_pa ? arena_size / PAGE_SIZE : 0;
 
-        if (min_addr == UINT64_MAX || max_addr <= min_addr) {
+        uint64_t words = 0;
+        for (uint32_t r = 0; r < region_count; ++r) words += hbitmap_t::storage_words(regions[r].pages);
+        uint64_t frame_bytes = total_pages * sizeof(page_t);
+        uint64_t bytes = frame_bytes + words * sizeof(uint64_t) + buddy::storage_bytes(arena_pages);
+
+        // Metadata has to stay reachable through the trampoline's direct map
+        uint64_t meta_pa = memblock::alloc(bytes, PAGE_SIZE, feron::mm::config::boot_map_limit);
+        if (!words || !meta_pa) {
             // No usable memory reported: keep allocator disabled
-            phys_base = phys_limit = total_pages = 0;
-            bitmap = nullptr; bitmap_bytes = 0;
+            region_count = 0; total_pages = 0;
+            memblock::active = false;
             return;
         }
+        bitmap_bytes = bytes;
+        frame_db_bytes = frame_bytes;
+
+        // Frame descriptors first (16-byte aligned), then the bitmaps, then the buddy links
+        auto* frame = feron::mm::phys_to_virt<page_t>(meta_pa);
+        memset(frame, 0, frame_bytes);
+        for (uint32_t r = 0; r < region_count; ++r) {
+            regions[r].frames = frame;
+            for (uint64_t i = 0; i < regions[r].pages; ++i) frame[i].zone = static_cast<uint8_t>(regions[r].zone);
+            frame += regions[r].pages;
+        }
+
+        auto* storage = reinterpret_cast<uint64_t*>(frame);
+        for (uint32_t r = 0; r < region_count; ++r) {
+            regions[r].map.attach(storage, regions[r].pages);
+            regions[r].map.release_range(0, regions[r].pages);
+            zones[regions[r].zone].free_pages += regions[r].pages;
+            storage += hbitmap_t::storage_words(regions[r].pages);
+        }
 
-        // Skip the first page for safety
-        phys_base = (min_addr + PAGE_SIZE) & ~(uint64_t)(PAGE_SIZE - 1);
-        phys_limit = max_addr & ~(uint64_t)(PAGE_SIZE - 1);
-        if (phys_limit <= phys_base) {
-            phys_base = phys_limit = total_pages = 0; bitmap = nullptr; bitmap_bytes = 0; return;
+        // Inherit the boot reservations: kernel image, boot info, heap, this metadata, the arena...
+        for (uint32_t i = 0; i < memblock::reserved.count; ++i) {
+            reserve_range(memblock::reserved.ranges[i].base, memblock::reserved.ranges[i].end);
+            set_reserved(memblock::reserved.ranges[i].base, memblock::reserved.ranges[i].end, true);
         }
+        memblock::active = false;
 
-        total_pages = (phys_limit - phys_base) / PAGE_SIZE;
-        bitmap_bytes = (total_pages + 7) / 8;
+        // The arena is reserved from the bitmaps' point of view, but its frames are free
+        if (arena_pages) {
+            buddy::init(arena_pa / PAGE_SIZE, arena_pages, storage);
+            set_reserved(arena_pa, arena_pa + arena_size, false);
+        }
+    }
+
+    // Zones to try for a mask, highest first, so scarce low memory is used last
+    template <typename F>
+    inline bool for_each_zone(uint32_t zone_mask, F&& fn) {
+        for (uint32_t z = ZONE_COUNT; z-- > 0;) {
+            if (!(zone_mask & (1u << z)) || !zones[z].free_pages) continue;
+            if (fn(zones[z])) return true;
+        }
+        return false;
+    }
 
-        bitmap = static_cast<uint8_t*>(malloc(bitmap_bytes));
-        if (!bitmap) { total_pages = 0; bitmap_bytes = 0; return; }
-        memset(bitmap, 0, bitmap_bytes);
+    // Guards the zones, the region bitmaps and the buddy arena
+    inline feron::sync::spinlock_t lock;
 
-        // Reserve non-usable regions within range by marking their bits (type != 1)
-        if (info.mmap && info.mmap_count > 0) {
-            for (uint32_t i = 0; i < info.mmap_count; ++i) {
-                auto e = info.mmap[i];
-                if (e.type != 1 && e.len) {
-                    uint64_t start = (e.addr < phys_base) ? phys_base : e.addr;
-                    uint64_t end   = (e.addr + e.len > phys_limit) ? phys_limit : (e.addr + e.len);
-                    if (end > start) {
-                        uint64_t sidx = (start - phys_base) / PAGE_SIZE;
-                        uint64_t eidx = (end   - phys_base) / PAGE_SIZE;
-                        for (uint64_t idx = sidx; idx < eidx; ++idx) bit_set(idx);
+    // Allocate one free page from the zones in zone_mask (caller holds lock)
+    inline uint64_t global_alloc(uint32_t zone_mask) {
+        uint64_t pa = 0;
+        for_each_zone(zone_mask, [&](zone_t& z){
+            for (uint32_t n = 0, r = z.region_hint; n < z.region_count; ++n) {
+                uint64_t idx = regions[r].map.alloc();
+                if (idx != hbitmap_t::NONE) {
+                    z.region_hint = r;
+                    --z.free_pages;
+                    pa = regions[r].base + idx * PAGE_SIZE;
+                    return true;
+                }
+                r = (r + 1 == z.first_region + z.region_count) ? z.first_region : r + 1;
+            }
+            return false;
+        });
+        return pa; // 0 when out of pages
+    }
+
+    // Up to n pages into out[] in a single pass over the bitmaps (caller holds lock)
+    inline std::size_t global_alloc_bulk(std::size_t n, uint64_t out[], uint32_t zone_mask) {
+        std::size_t got = 0;
+        for_each_zone(zone_mask, [&](zone_t& z){
+            for (uint32_t k = 0, r = z.region_hint; k < z.region_count && got < n; ++k) {
+                auto& reg = regions[r];
+                while (got < n) {
+                    uint64_t w = reg.map.find_free_word();
+                    if (w == hbitmap_t::NONE) break;
+
+                    // Drain every free bit of this word before moving on
+                    while (reg.map.l0[w] != ~0ull && got < n) {
+                        out[got++] = reg.base + reg.map.take_from(w) * PAGE_SIZE;
+                        --z.free_pages;
                     }
+                    z.region_hint = r;
                 }
+                r = (r + 1 == z.first_region + z.region_count) ? z.first_region : r + 1;
             }
+            return got == n;
+        });
+        return got;
+    }
+
+    // Return one page to the buddy arena or its region bitmap (caller holds lock)
+    inline void global_free(uint64_t pa) {
+        if (buddy::owns(pa / PAGE_SIZE)) { buddy::free(pa / PAGE_SIZE, 0); return; }
+        uint32_t r = find_region(pa);
+        if (r == region_count) return;
+        uint64_t idx = (pa - regions[r].base) / PAGE_SIZE;
+        if (!regions[r].map.test(idx)) return; // already free
+        regions[r].map.clear(idx);
+        ++zones[regions[r].zone].free_pages;
+    }
+
+    // Descriptor bookkeeping for a block of 2^order frames at pa leaving / entering the allocator
+    inline void frame_alloced(uint64_t pa, unsigned order) {
+        if (page_t* pg = page_of(pa)) {
+            pg->refcount = 1;
+            pg->flags = order ? PG_HEAD : 0;
+            pg->order = static_cast<uint8_t>(order);
+            pg->owner = 0;
         }
+    }
 
-        // Reserve low critical pages: first few MB for identity, VGA (0xB8000), kernel image, etc.
-        auto reserve_pa_range = [&](uint64_t start, uint64_t end){
-            if (start < phys_base) start = phys_base;
-            if (end   > phys_limit) end = phys_limit;
-            if (end <= start) return;
-            uint64_t sidx = (start - phys_base) / PAGE_SIZE;
-            uint64_t eidx = (end   - phys_base) / PAGE_SIZE;
-            for (uint64_t idx = sidx; idx < eidx; ++idx) bit_set(idx);
-        };
+    inline void frame_freed(uint64_t pa) {
+        if (page_t* pg = page_of(pa)) {
+            pg->refcount = 0;
+            pg->flags = 0;
+            pg->order = 0;
+            pg->owner = 0;
+        }
+    }
+
+    // Per-CPU page magazines. Each (cpu, level) pair owns a small LIFO stack of free frames,
+    // so alloc_page()/free_page() only touch the global state once per MAG_BATCH pages and
+    // a just-freed frame is handed out again while it is still in the cache. An interrupt
+    // handler uses its own magazine, so the fast path needs neither the lock nor cli.
+    constexpr uint32_t MAG_SIZE  = 64;
+    constexpr uint32_t MAG_BATCH = 16;
+
+    struct alignas(64) magazine_t {
+        uint32_t count = 0;
+        uint64_t frames[MAG_SIZE];   // frames[count - 1] is the most recently freed
+    };
+
+    inline magazine_t magazines[feron::cpu::context::MAX_CPUS][feron::cpu::context::LEVEL_COUNT];
+
+    inline magazine_t& local_magazine() {
+        return magazines[feron::cpu::context::id()][feron::cpu::context::level()];
+    }
 
-        // Reserve first 16 MiB for boot identity and devices
-        reserve_pa_range(phys_base, phys_base + 16ull * 1024 * 1024);
+    // Pages sitting in magazines; free, but not visible to the zones
+    inline uint64_t cached_pages() {
+        uint64_t n = 0;
+        for (auto& cpu : magazines) for (auto& m : cpu) n += m.count;
+        return n;
+    }
 
-        // Reserve VGA text page (round to page)
-        reserve_pa_range(0x00000000000B8000ull & ~(PAGE_SIZE - 1), (0xB8000ull & ~(PAGE_SIZE - 1)) + PAGE_SIZE);
+    inline uint64_t free_pages_count() {
+        uint64_t n = buddy::free_pages + cached_pages();
+        for (auto& z : zones) n += z.free_pages;
+        return n;
+    }
+
+    // Allocate one free page from the zones in zone_mask (returns physical address or 0)
+    inline uint64_t alloc_page(uint32_t zone_mask) {
+        uint64_t pa;
+        {
+            feron::sync::irq_lock_guard g(lock);
+            pa = global_alloc(zone_mask);
+        }
+        if (pa) frame_alloced(pa, 0);
+        return pa;
     }
 
-    // Allocate one free page (returns physical address or 0)
+    // Any zone: served from the local magazine, refilled MAG_BATCH pages at a time
     inline uint64_t alloc_page() {
-        if (!bitmap || total_pages == 0) return 0;
-        for (uint64_t idx = 0; idx < total_pages; ++idx) {
-            if (!bit_get(idx)) {
-                bit_set(idx);
-                return index_to_pa(idx);
+        auto& m = local_magazine();
+        if (!m.count) {
+            feron::sync::irq_lock_guard g(lock);
+            m.count = static_cast<uint32_t>(global_alloc_bulk(MAG_BATCH, m.frames, ZM_ANY));
+            if (!m.count) return 0;
+        }
+        uint64_t pa = m.frames[--m.count];
+        frame_alloced(pa, 0);
+        return pa;
+    }
+
+    // Allocate up to n pages into out[] in a single pass over the bitmaps.
+    // Returns how many pages were written (less than n only when the zones run out).
+    inline std::size_t alloc_pages_bulk(std::size_t n, uint64_t out[], uint32_t zone_mask = ZM_ANY) {
+        if (!out) return 0;
+        std::size_t got;
+        {
+            feron::sync::irq_lock_guard g(lock);
+            got = global_alloc_bulk(n, out, zone_mask);
+        }
+        for (std::size_t i = 0; i < got; ++i) frame_alloced(out[i], 0);
+        return got;
+    }
+
+    // Frames go onto the local magazine; a full magazine hands its MAG_BATCH oldest
+    // (coldest) frames back to the global allocator and keeps the hot ones.
+    inline void magazine_push(uint64_t pa) {
+        auto& m = local_magazine();
+        if (m.count == MAG_SIZE) {
+            {
+                feron::sync::irq_lock_guard g(lock);
+                for (uint32_t i = 0; i < MAG_BATCH; ++i) global_free(m.frames[i]);
             }
+            for (uint32_t i = MAG_BATCH; i < MAG_SIZE; ++i) m.frames[i - MAG_BATCH] = m.frames[i];
+            m.count -= MAG_BATCH;
         }
-        return 0; // out of pages
+        m.frames[m.count++] = pa;
     }
 
+    // Return an unshared frame; frames handed out with get_page go back through put_page
     inline void free_page(uint64_t pa) {
-        if (!bitmap || pa < phys_base || pa >= phys_limit) return;
-        uint64_t idx = pa_to_index(pa);
-        bit_clear(idx);
+        if (!pa || (pa & (PAGE_SIZE - 1))) return;
+        page_t* pg = page_of(pa);
+        if (!pg || (pg->flags & PG_RESERVED) || !pg->refcount) return; // not RAM, reserved, or already free
+        frame_freed(pa);
+        magazine_push(pa);
+    }
+
+    // Allocate 2^order physically contiguous pages, aligned to their size (returns physical address or 0).
+    // Blocks come from the buddy arena; single pages fall back to the bitmap when the arena is empty.
+    inline uint64_t alloc_pages(unsigned order) {
+        {
+            feron::sync::irq_lock_guard g(lock);
+            uint64_t pfn = buddy::alloc(order);
+            if (pfn != buddy::NO_PFN) {
+                frame_alloced(pfn * PAGE_SIZE, order);
+                return pfn * PAGE_SIZE;
+            }
+        }
+        return order == 0 ? alloc_page() : 0;
     }
+
+    // Hand a block whose last reference is gone back to the buddy arena (no checks)
+    inline void release_block(uint64_t pa, unsigned order) {
+        feron::sync::irq_lock_guard g(lock);
+        frame_freed(pa);
+        buddy::free(pa / PAGE_SIZE, order);
+    }
+
+    inline void free_pages(uint64_t pa, unsigned order) {
+        if (buddy::owns(pa / PAGE_SIZE)) {
+            // the same checks as free_page, made before the descriptor is wiped: a second
+            // free or a wrong order must leave a live block alone
+            feron::sync::irq_lock_guard g(lock);
+            page_t* pg = page_of(pa);
+            if (pg && (!pg->refcount || (pg->flags & PG_RESERVED) || pg->order != order ||
+                       (order && !(pg->flags & PG_HEAD)))) return;
+            frame_freed(pa);
+            buddy::free(pa / PAGE_SIZE, order);
+        } else if (order == 0) {
+            free_page(pa);
+        }
+    }
+
+    // Take another reference on an allocated frame (or block head)
+    inline void get_page(page_t* pg) {
+        if (pg) __atomic_add_fetch(&pg->refcount, 1, __ATOMIC_RELAXED);
+    }
+
+    // Drop a reference; the last put returns the frame (or whole block) to the allocator.
+    // Returns true when the frame was freed.
+    inline bool put_page(uint64_t pa) {
+        page_t* pg = page_of(pa);
+        if (!pg || (pg->flags & PG_RESERVED) || !pg->refcount) return false;
+        if (__atomic_sub_fetch(&pg->refcount, 1, __ATOMIC_ACQ_REL)) return false;
+        unsigned order = (pg->flags & PG_HEAD) ? pg->order : 0;
+        if (order) { release_block(pa, order); return true; }
+        frame_freed(pa);
+        magazine_push(pa);
+        return true;
+    }
+
+    inline void get_page(uint64_t pa) { get_page(page_of(pa)); }
 }
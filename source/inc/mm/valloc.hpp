@@ -1,24 +1,385 @@
 #pragma once
 
 #include <cstdint>
+#include "../sync/spinlock.hpp"
+#include "kmem_cache.hpp"
 
+// Kernel virtual address allocator over the dynamic VA pool.
+// Free extents live in an AVL tree ordered by address, so a freed range finds its
+// neighbours and coalesces in O(log n), and on two-level segregated size lists (TLSF):
+// the first level is log2 of the page count, the second splits each power of two into
+// eight bins. Allocation rounds the request up to a bin boundary and takes the head of
+// the first non-empty bin at or above it, found with two bit scans, so any extent there
+// fits without walking a list.
+// Recently freed 1, 2 and 4 page ranges sit in small LIFO quick caches and are handed
+// straight back to requests of the same size; they only rejoin the tree when an
+// allocation would otherwise fail.
+// Extent descriptors come from a static pool, and only once that runs dry spill into a
+// kmem_cache. valloc is set up and used before paging::init extends the direct map past the
+// low 4 GiB, and a slab built from a pfa frame above that would not be reachable yet.
 namespace feron::mm::valloc {
+    constexpr uint64_t PAGE          = 4096;
+    constexpr uint32_t MAX_EXTENTS   = 256;     // static descriptors
+    constexpr uint32_t FL_COUNT      = 64;      // first level: log2 of the page count
+    constexpr uint32_t SL_SHIFT      = 3;
+    constexpr uint32_t SL_COUNT      = 1u << SL_SHIFT;   // second-level bins per power of two
+    constexpr uint32_t QUICK_CLASSES = 3;       // 1, 2 and 4 pages
+    constexpr uint32_t QUICK_SIZE    = 16;
+
+    struct extent_t {
+        uint64_t base = 0;
+        uint64_t size = 0;
+        extent_t* left = nullptr;      // address tree
+        extent_t* right = nullptr;
+        extent_t* next = nullptr;      // size-class list, or the spare list
+        extent_t* prev = nullptr;
+        int32_t height = 0;
+        uint32_t bin = 0;               // fl * SL_COUNT + sl
+    };
+
+    struct quick_cache_t {
+        uint64_t va[QUICK_SIZE];
+        uint32_t count = 0;
+    };
+
     inline uint64_t va_base = 0;
     inline uint64_t va_end  = 0;
-    inline uint64_t cursor  = 0;
+
+    inline extent_t extents[MAX_EXTENTS];
+    inline extent_t* spare = nullptr;               // unused static descriptors
+    inline feron::mm::kmem_cache<extent_t> extent_cache;
+    inline extent_t* root = nullptr;
+    inline extent_t* bins[FL_COUNT * SL_COUNT];
+    inline uint64_t fl_mask = 0;                    // bit f set = some bin of level f non-empty
+    inline uint8_t sl_mask[FL_COUNT];               // bit s set = bins[f * SL_COUNT + s] non-empty
+    inline quick_cache_t quick[QUICK_CLASSES];
+    inline uint64_t free_bytes = 0;                 // tree and quick caches together
+    inline feron::sync::spinlock_t lock;
+
+    // Bin holding extents of size bytes (rounded down)
+    inline uint32_t bin_of(uint64_t size) {
+        uint64_t pages = size / PAGE;
+        uint32_t fl = 63u - static_cast<uint32_t>(__builtin_clzll(pages));
+        uint32_t sl = fl >= SL_SHIFT ? static_cast<uint32_t>(pages >> (fl - SL_SHIFT)) & (SL_COUNT - 1)
+                                     : static_cast<uint32_t>(pages << (SL_SHIFT - fl)) & (SL_COUNT - 1);
+        return fl * SL_COUNT + sl;
+    }
+
+    // First non-empty bin at or above bin, or FL_COUNT * SL_COUNT
+    inline uint32_t find_bin(uint32_t bin) {
+        uint32_t fl = bin / SL_COUNT, sl = bin % SL_COUNT;
+        uint32_t sl_bits = sl_mask[fl] & (0xFFu << sl) & 0xFFu;
+        if (!sl_bits) {
+            uint64_t fl_bits = fl + 1 < FL_COUNT ? fl_mask & (~0ull << (fl + 1)) : 0;
+            if (!fl_bits) return FL_COUNT * SL_COUNT;
+            fl = static_cast<uint32_t>(__builtin_ctzll(fl_bits));
+            sl_bits = sl_mask[fl];
+        }
+        return fl * SL_COUNT + static_cast<uint32_t>(__builtin_ctz(sl_bits));
+    }
+
+    // Quick cache for an exact size, or -1
+    inline int quick_index(uint64_t size) {
+        switch (size) {
+            case PAGE:     return 0;
+            case 2 * PAGE: return 1;
+            case 4 * PAGE: return 2;
+            default:       return -1;
+        }
+    }
+
+    // --- descriptors and size-class lists (caller holds lock) ---
+
+    inline extent_t* new_extent(uint64_t base, uint64_t size) {
+        extent_t* e = spare;
+        if (e) spare = e->next;
+        else if (!(e = extent_cache.alloc())) return nullptr;
+        *e = {};
+        e->base = base;
+        e->size = size;
+        e->height = 1;
+        return e;
+    }
+
+    inline void drop_extent(extent_t* e) {
+        if (e < extents || e >= extents + MAX_EXTENTS) {
+            extent_cache.free(e);
+            return;
+        }
+        e->next = spare;
+        spare = e;
+    }
+
+    inline void list_add(extent_t* e) {
+        e->bin = bin_of(e->size);
+        e->prev = nullptr;
+        e->next = bins[e->bin];
+        if (e->next) e->next->prev = e;
+        bins[e->bin] = e;
+        sl_mask[e->bin / SL_COUNT] |= static_cast<uint8_t>(1u << (e->bin % SL_COUNT));
+        fl_mask |= 1ull << (e->bin / SL_COUNT);
+    }
+
+    inline void list_remove(extent_t* e) {
+        if (e->prev) e->prev->next = e->next;
+        else bins[e->bin] = e->next;
+        if (e->next) e->next->prev = e->prev;
+        if (!bins[e->bin]) {
+            uint32_t fl = e->bin / SL_COUNT;
+            sl_mask[fl] &= static_cast<uint8_t>(~(1u << (e->bin % SL_COUNT)));
+            if (!sl_mask[fl]) fl_mask &= ~(1ull << fl);
+        }
+    }
+
+    // Change an extent's bounds without moving it in the tree (its order among neighbours holds)
+    inline void resize(extent_t* e, uint64_t base, uint64_t size) {
+        list_remove(e);
+        e->base = base;
+        e->size = size;
+        list_add(e);
+    }
+
+    // --- address tree (AVL) ---
+
+    inline int32_t height(extent_t* n) { return n ? n->height : 0; }
+
+    inline void update(extent_t* n) {
+        int32_t l = height(n->left), r = height(n->right);
+        n->height = (l > r ? l : r) + 1;
+    }
+
+    inline extent_t* rotate_right(extent_t* n) {
+        extent_t* l = n->left;
+        n->left = l->right;
+        l->right = n;
+        update(n);
+        update(l);
+        return l;
+    }
+
+    inline extent_t* rotate_left(extent_t* n) {
+        extent_t* r = n->right;
+        n->right = r->left;
+        r->left = n;
+        update(n);
+        update(r);
+        return r;
+    }
+
+    inline extent_t* rebalance(extent_t* n) {
+        update(n);
+        int32_t bal = height(n->left) - height(n->right);
+        if (bal > 1) {
+            if (height(n->left->left) < height(n->left->right)) n->left = rotate_left(n->left);
+            return rotate_right(n);
+        }
+        if (bal < -1) {
+            if (height(n->right->right) < height(n->right->left)) n->right = rotate_right(n->right);
+            return rotate_left(n);
+        }
+        return n;
+    }
+
+    inline extent_t* tree_insert(extent_t* n, extent_t* e) {
+        if (!n) return e;
+        if (e->base < n->base) n->left = tree_insert(n->left, e);
+        else n->right = tree_insert(n->right, e);
+        return rebalance(n);
+    }
+
+    // Unlink the leftmost node of n's subtree into min
+    inline extent_t* tree_take_min(extent_t* n, extent_t*& min) {
+        if (!n->left) { min = n; return n->right; }
+        n->left = tree_take_min(n->left, min);
+        return rebalance(n);
+    }
+
+    inline extent_t* tree_remove(extent_t* n, extent_t* e) {
+        if (!n) return nullptr;
+        if (e->base < n->base) n->left = tree_remove(n->left, e);
+        else if (e->base > n->base) n->right = tree_remove(n->right, e);
+        else {
+            if (!n->left || !n->right) return n->left ? n->left : n->right;
+            extent_t* succ = nullptr;
+            extent_t* right = tree_take_min(n->right, succ);
+            succ->left = n->left;
+            succ->right = right;
+            return rebalance(succ);
+        }
+        return rebalance(n);
+    }
+
+    // Closest free extents below and at-or-above va
+    inline void neighbours(uint64_t va, extent_t*& pred, extent_t*& succ) {
+        pred = succ = nullptr;
+        for (extent_t* n = root; n;) {
+            if (n->base < va) { pred = n; n = n->right; }
+            else { succ = n; n = n->left; }
+        }
+    }
+
+    // --- free extents (caller holds lock) ---
+
+    // Return [va, va + size) to the tree, merging with adjacent extents
+    inline bool insert_free(uint64_t va, uint64_t size) {
+        extent_t *pred, *succ;
+        neighbours(va, pred, succ);
+        if (pred && pred->base + pred->size > va) return false;   // overlaps a free range
+        if (succ && succ->base < va + size) return false;
+
+        bool join_pred = pred && pred->base + pred->size == va;
+        bool join_succ = succ && succ->base == va + size;
+        if (join_pred && join_succ) {
+            resize(pred, pred->base, pred->size + size + succ->size);
+            list_remove(succ);
+            root = tree_remove(root, succ);
+            drop_extent(succ);
+        } else if (join_pred) {
+            resize(pred, pred->base, pred->size + size);
+        } else if (join_succ) {
+            resize(succ, va, succ->size + size);
+        } else {
+            extent_t* e = new_extent(va, size);
+            if (!e) return false;
+            root = tree_insert(root, e);
+            list_add(e);
+        }
+        return true;
+    }
+
+    // First address in e that can hold size bytes at align, or 0
+    inline uint64_t fit(const extent_t* e, uint64_t size, uint64_t align) {
+        uint64_t a = (e->base + align - 1) & ~(align - 1);
+        return (a >= e->base && a + size <= e->base + e->size && a + size > a) ? a : 0;
+    }
+
+    // Carve [a, a + size) out of e, keeping the head in e and the tail in a new extent
+    inline bool carve(extent_t* e, uint64_t a, uint64_t size) {
+        uint64_t head = a - e->base;
+        uint64_t tail = e->base + e->size - (a + size);
+        if (head && tail) {
+            extent_t* t = new_extent(a + size, tail);
+            if (!t) return false;
+            resize(e, e->base, head);
+            root = tree_insert(root, t);
+            list_add(t);
+        } else if (head) {
+            resize(e, e->base, head);
+        } else if (tail) {
+            resize(e, a + size, tail);
+        } else {
+            list_remove(e);
+            root = tree_remove(root, e);
+            drop_extent(e);
+        }
+        return true;
+    }
+
+    // Good fit in O(1): the request plus worst-case alignment slack, rounded up to the next
+    // bin boundary, so the head of any bin found is large enough. Only when that finds
+    // nothing is the request's own (floor) bin scanned for an extent that happens to fit.
+    inline uint64_t take(uint64_t size, uint64_t align) {
+        uint64_t need = size + (align - PAGE);
+        if (need < size) return 0;
+        uint32_t fl = 63u - static_cast<uint32_t>(__builtin_clzll(need / PAGE));
+        uint64_t round = fl > SL_SHIFT ? (PAGE << (fl - SL_SHIFT)) - 1 : 0;
+        uint32_t bin = need + round < need ? FL_COUNT * SL_COUNT : find_bin(bin_of(need + round));
+
+        extent_t* e = bin < FL_COUNT * SL_COUNT ? bins[bin] : nullptr;
+        uint64_t at = e ? fit(e, size, align) : 0;
+        if (!at) {
+            for (e = bins[bin_of(size)]; e; e = e->next) {
+                if ((at = fit(e, size, align))) break;
+            }
+        }
+        if (!e || !carve(e, at, size)) return 0;
+        return at;
+    }
+
+    // True when [va, va + size) overlaps a quick-cached range
+    inline bool quick_overlaps(uint64_t va, uint64_t size) {
+        for (uint32_t q = 0; q < QUICK_CLASSES; ++q) {
+            for (uint32_t i = 0; i < quick[q].count; ++i) {
+                if (quick[q].va[i] < va + size && va < quick[q].va[i] + (PAGE << q)) return true;
+            }
+        }
+        return false;
+    }
+
+    // Move every quick-cached range back into the tree so it can coalesce
+    inline void drain_quick() {
+        for (uint32_t q = 0; q < QUICK_CLASSES; ++q) {
+            quick_cache_t& qc = quick[q];
+            uint32_t kept = 0;
+            for (uint32_t i = 0; i < qc.count; ++i) {
+                // no descriptor left for it: keep it cached
+                if (!insert_free(qc.va[i], PAGE << q)) qc.va[kept++] = qc.va[i];
+            }
+            qc.count = kept;
+        }
+    }
+
+    // --- public API ---
 
     // Initialize allocator over [base, base+size)
     inline void init(uint64_t base, uint64_t size) {
+        feron::sync::irq_lock_guard g(lock);
         va_base = base;
-        va_end  = base + size;
-        cursor  = base;
+        va_end  = base + (size & ~(PAGE - 1));
+        root = nullptr;
+        spare = nullptr;
+        for (uint32_t i = MAX_EXTENTS; i-- > 0;) drop_extent(&extents[i]);
+        for (auto& b : bins) b = nullptr;
+        for (auto& m : sl_mask) m = 0;
+        fl_mask = 0;
+        for (auto& q : quick) q.count = 0;
+        free_bytes = 0;
+        if (va_end > va_base && insert_free(va_base, va_end - va_base)) free_bytes = va_end - va_base;
     }
 
-    // Allocate a contiguous VA range (size must be multiple of page size)
-    inline uint64_t alloc_range(uint64_t size, uint64_t align = 4096) {
-        uint64_t aligned = (cursor + (align - 1)) & ~(align - 1);
-        if (aligned + size > va_end) return 0;
-        cursor = aligned + size;
-        return aligned;
+    // Allocate a contiguous VA range (size is rounded up to whole pages, align to a power of two
+    // of at least a page). Returns 0 when no free extent fits.
+    inline uint64_t alloc_range(uint64_t size, uint64_t align = PAGE) {
+        if (!size) return 0;
+        size = (size + PAGE - 1) & ~(PAGE - 1);
+        if (align < PAGE) align = PAGE;
+        if (align & (align - 1)) return 0;
+
+        feron::sync::irq_lock_guard g(lock);
+        int q = quick_index(size);
+        if (q >= 0 && align == PAGE && quick[q].count) {
+            free_bytes -= size;
+            return quick[q].va[--quick[q].count];
+        }
+
+        uint64_t va = take(size, align);
+        if (!va) {
+            drain_quick();
+            va = take(size, align);
+        }
+        if (va) free_bytes -= size;
+        return va;
+    }
+
+    // Give back a range from alloc_range. Ranges outside the pool or overlapping free
+    // space (double frees) are rejected.
+    inline bool free_range(uint64_t va, uint64_t size) {
+        if (!size || (va & (PAGE - 1))) return false;
+        size = (size + PAGE - 1) & ~(PAGE - 1);
+        if (va < va_base || va >= va_end || size > va_end - va) return false;
+
+        feron::sync::irq_lock_guard g(lock);
+        if (quick_overlaps(va, size)) return false;
+        int q = quick_index(size);
+        if (q >= 0 && quick[q].count < QUICK_SIZE) {
+            extent_t *pred, *succ;
+            neighbours(va, pred, succ);
+            if ((pred && pred->base + pred->size > va) || (succ && succ->base < va + size)) return false;
+            quick[q].va[quick[q].count++] = va;
+        } else if (!insert_free(va, size)) {
+            return false;
+        }
+        free_bytes += size;
+        return true;
     }
 }
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "page.hpp"
+#include "paging.hpp"
+#include "pfa.hpp"
+#include "valloc.hpp"
+#include "zeropool.hpp"
+
+// Virtually contiguous kernel allocations backed by individual frames, so large buffers
+// never depend on physically contiguous memory. Each area gets a fresh valloc range with
+// an unmapped guard page on either side; overruns fault instead of corrupting a neighbour.
+// The first frame of an area carries PG_VMALLOC and the page count in page_t::owner,
+// so vfree needs nothing but the pointer.
+namespace feron::mm::vmalloc {
+    constexpr uint64_t PAGE  = feron::mm::pfa::PAGE_SIZE;
+    constexpr uint64_t GUARD = PAGE;
+    constexpr std::size_t BATCH = 64;   // frames taken from pfa per bulk call
+
+    // Unmap [va, va + pages) and free its frames. The frames are chained through
+    // page_t::owner while still mapped, so the whole range goes with one TLB flush.
+    inline void release(uint64_t va, uint64_t pages) {
+        uint64_t chain = 0;
+        for (uint64_t i = pages; i-- > 0;) {
+            uint64_t pa = feron::mm::paging::virt_to_phys(va + i * PAGE);
+            feron::mm::page_t* pg = pa ? feron::mm::pfa::page_of(pa) : nullptr;
+            if (!pg) continue;
+            pg->owner = chain;
+            chain = pa;
+        }
+
+        feron::mm::paging::unmap_range(va, pages * PAGE);
+
+        while (chain) {
+            uint64_t pa = chain;
+            chain = feron::mm::pfa::page_of(pa)->owner;
+            feron::mm::pfa::free_page(pa);
+        }
+    }
+
+    // Map [va, va + pages) to fresh frames, filling one page table at a time.
+    // Returns how many pages were mapped (less than pages when memory runs out).
+    inline uint64_t populate(uint64_t va, uint64_t pages, uint64_t flags) {
+        uint64_t frames[BATCH];
+        uint64_t done = 0;
+        while (done < pages) {
+            uint64_t want = pages - done < BATCH ? pages - done : BATCH;
+            std::size_t got = feron::mm::pfa::alloc_pages_bulk(want, frames);
+
+            for (std::size_t i = 0; i < got;) {
+                uint64_t at = va + done * PAGE;
+                uint64_t* pte = feron::mm::paging::walk_create(at);
+                if (!pte) {
+                    for (; i < got; ++i) feron::mm::pfa::free_page(frames[i]);
+                    return done;
+                }
+                // the range is fresh, so no entry was present and nothing needs a flush
+                uint64_t leaf = feron::mm::paging::leaf_flags_for(at, flags);
+                uint64_t room = 512 - feron::mm::paging::idx(at, 1);
+                for (; room && i < got; --room, ++i, ++done, ++pte) {
+                    *pte = feron::mm::paging::leaf_entry(frames[i], leaf, 1);
+                }
+            }
+            if (got < want) return done;
+        }
+        return done;
+    }
+
+    // As populate, but with frames from the zeroed-page pool, so the range reads as zero
+    // without the caller clearing it
+    inline uint64_t populate_zeroed(uint64_t va, uint64_t pages, uint64_t flags) {
+        uint64_t done = 0;
+        while (done < pages) {
+            uint64_t at = va + done * PAGE;
+            uint64_t* pte = feron::mm::paging::walk_create(at);
+            if (!pte) return done;
+            uint64_t leaf = feron::mm::paging::leaf_flags_for(at, flags);
+            uint64_t room = 512 - feron::mm::paging::idx(at, 1);
+            for (; room && done < pages; --room, ++done, ++pte) {
+                uint64_t pa = feron::mm::zeropool::alloc_zeroed_page();
+                if (!pa) return done;
+                *pte = feron::mm::paging::leaf_entry(pa, leaf, 1);
+            }
+        }
+        return done;
+    }
+
+    // Allocate size bytes (rounded up to pages) of virtually contiguous memory; nullptr on failure.
+    // The contents are not cleared.
+    inline void* vmalloc(std::size_t size, uint64_t flags = feron::mm::paging::P_PRESENT | feron::mm::paging::P_RW | feron::mm::paging::P_NX) {
+        if (!size) return nullptr;
+        uint64_t pages = (size + PAGE - 1) / PAGE;
+        uint64_t span = pages * PAGE + 2 * GUARD;
+        uint64_t base = feron::mm::valloc::alloc_range(span);
+        if (!base) return nullptr;
+
+        uint64_t va = base + GUARD;
+        uint64_t mapped = populate(va, pages, flags | feron::mm::paging::P_PRESENT);
+        if (mapped < pages) {
+            release(va, mapped);
+            feron::mm::valloc::free_range(base, span);
+            return nullptr;
+        }
+
+        feron::mm::page_t* head = feron::mm::pfa::page_of(feron::mm::paging::virt_to_phys(va));
+        head->flags |= PG_VMALLOC;
+        head->owner = pages;
+        return reinterpret_cast<void*>(va);
+    }
+
+    // Pages behind a vmalloc pointer, or 0 when ptr is not the start of a live area
+    inline uint64_t area_pages(const void* ptr) {
+        uint64_t va = reinterpret_cast<uint64_t>(ptr);
+        if (!ptr || (va & (PAGE - 1))) return 0;
+        uint64_t pa = feron::mm::paging::virt_to_phys(va);
+        feron::mm::page_t* head = pa ? feron::mm::pfa::page_of(pa) : nullptr;
+        return (head && (head->flags & PG_VMALLOC)) ? head->owner : 0;
+    }
+
+    inline void vfree(void* ptr) {
+        uint64_t pages = area_pages(ptr);
+        if (!pages) return;
+        uint64_t va = reinterpret_cast<uint64_t>(ptr);
+        feron::mm::pfa::page_of(feron::mm::paging::virt_to_phys(va))->flags &= static_cast<uint16_t>(~PG_VMALLOC);
+
+        release(va, pages);
+        feron::mm::valloc::free_range(va - GUARD, pages * PAGE + 2 * GUARD);
+    }
+}
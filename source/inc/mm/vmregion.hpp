@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstdint>
+#include "../sync/spinlock.hpp"
+#include "hhdm.hpp"
+#include "paging.hpp"
+#include "pfa.hpp"
+#include "valloc.hpp"
+#include "zeropool.hpp"
+
+// Kernel virtual ranges that are populated on first touch. A region only reserves
+// address space; the page-fault handler asks handle_fault() to back the faulting page
+// according to the region's policy and resumes the access.
+namespace feron::mm::vmregion {
+    constexpr uint32_t MAX_REGIONS = 64;
+
+    enum backing_t : uint8_t {
+        BACK_ZERO,      // fresh zero-filled frames
+        BACK_PHYS,      // fixed physical window: base maps to phys, linearly
+        BACK_FILL,      // zero-filled frame passed to a callback before it is mapped
+    };
+
+    // Fill the new page (direct-map pointer) for va; returning false makes the access fault
+    using fill_fn = bool (*)(void* ctx, uint64_t va, void* page);
+
+    struct region_t {
+        uint64_t base = 0;
+        uint64_t end = 0;       // exclusive
+        uint64_t flags = 0;     // PTE flags for populated pages
+        uint64_t phys = 0;      // BACK_PHYS: physical address of base
+        fill_fn fill = nullptr; // BACK_FILL
+        void* ctx = nullptr;
+        backing_t backing = BACK_ZERO;
+        bool owns_va = false;   // address space came from valloc (reserve) and goes back on destroy
+    };
+
+    // Sorted by base, non-overlapping
+    inline region_t regions[MAX_REGIONS];
+    inline uint32_t count = 0;
+    inline feron::sync::spinlock_t lock;
+
+    // Index of the region containing va, or count (caller holds lock)
+    inline uint32_t find(uint64_t va) {
+        uint32_t lo = 0, hi = count;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (va < regions[mid].base) hi = mid;
+            else if (va >= regions[mid].end) lo = mid + 1;
+            else return mid;
+        }
+        return count;
+    }
+
+    // Register [base, base + size) (page aligned); nothing is mapped yet. owns_va hands the
+    // range back to valloc on destroy.
+    inline bool create(uint64_t base, uint64_t size, backing_t backing, uint64_t flags,
+                       uint64_t phys = 0, fill_fn fill = nullptr, void* ctx = nullptr, bool owns_va = false) {
+        if (!size || ((base | size) & (feron::mm::pfa::PAGE_SIZE - 1))) return false;
+        if (backing == BACK_FILL && !fill) return false;
+
+        feron::sync::irq_lock_guard g(lock);
+        if (count == MAX_REGIONS) return false;
+        uint32_t i = 0;
+        while (i < count && regions[i].base < base) ++i;
+        if (i > 0 && regions[i - 1].end > base) return false;
+        if (i < count && regions[i].base < base + size) return false;
+
+        for (uint32_t k = count; k > i; --k) regions[k] = regions[k - 1];
+        regions[i] = { base, base + size, flags | feron::mm::paging::P_PRESENT, phys, fill, ctx, backing, owns_va };
+        ++count;
+        return true;
+    }
+
+    // Reserve fresh kernel address space for a demand-paged region (returns its base or 0)
+    inline uint64_t reserve(uint64_t size, backing_t backing, uint64_t flags,
+                            uint64_t phys = 0, fill_fn fill = nullptr, void* ctx = nullptr) {
+        size = (size + feron::mm::pfa::PAGE_SIZE - 1) & ~(feron::mm::pfa::PAGE_SIZE - 1);
+        uint64_t va = feron::mm::valloc::alloc_range(size);
+        if (!va) return 0;
+        if (!create(va, size, backing, flags, phys, fill, ctx, true)) {
+            feron::mm::valloc::free_range(va, size);
+            return 0;
+        }
+        return va;
+    }
+
+    // Forget the region starting at base, unmap it and free the frames it populated.
+    // As in vmalloc::release, the frames are chained through page_t::owner and only
+    // dropped once the range is unmapped and flushed, so no stale translation can reach
+    // a frame that has already been reused.
+    inline bool destroy(uint64_t base) {
+        region_t r;
+        {
+            feron::sync::irq_lock_guard g(lock);
+            uint32_t i = find(base);
+            if (i == count || regions[i].base != base) return false;
+            r = regions[i];
+            for (uint32_t k = i + 1; k < count; ++k) regions[k - 1] = regions[k];
+            --count;
+        }
+
+        uint64_t chain = 0;
+        if (r.backing != BACK_PHYS) {
+            // demand-populated pages are 4 KiB leaves; skip 2 MiB at a time where no table exists
+            for (uint64_t va = r.base; va < r.end;) {
+                if (!feron::mm::paging::lookup(va, 1)) {
+                    va = (va & ~(feron::mm::paging::SIZE_2M - 1)) + feron::mm::paging::SIZE_2M;
+                    continue;
+                }
+                uint64_t pa = feron::mm::paging::virt_to_phys(va);
+                if (feron::mm::page_t* pg = pa ? feron::mm::pfa::page_of(pa) : nullptr) {
+                    pg->owner = chain;
+                    chain = pa;
+                }
+                va += feron::mm::pfa::PAGE_SIZE;
+            }
+        }
+        feron::mm::paging::unmap_range(r.base, r.end - r.base);
+
+        while (chain) {
+            uint64_t pa = chain;
+            chain = feron::mm::pfa::page_of(pa)->owner;
+            feron::mm::pfa::put_page(pa);
+        }
+        if (r.owns_va) feron::mm::valloc::free_range(r.base, r.end - r.base);
+        return true;
+    }
+
+    // Back the page containing addr if a region covers it. Returns false for accesses
+    // no region explains (protection violations, holes), which stay fatal.
+    inline bool handle_fault(uint64_t addr, uint64_t error_code) {
+        if (error_code & 1) return false; // page was present: a real protection fault
+
+        feron::sync::irq_lock_guard g(lock);
+        uint32_t i = find(addr);
+        if (i == count) return false;
+        const region_t& r = regions[i];
+        const uint64_t page = addr & ~(feron::mm::pfa::PAGE_SIZE - 1);
+
+        // another CPU may have populated it while we waited for the lock
+        if (feron::mm::paging::virt_to_phys(page)) return true;
+
+        if (r.backing == BACK_PHYS) {
+            // a whole aligned 2 MiB block of the window goes in as one leaf
+            const uint64_t big = feron::mm::paging::SIZE_2M;
+            uint64_t block = page & ~(big - 1), block_pa = r.phys + (block - r.base);
+            if (block >= r.base && block + big <= r.end && !(block_pa & (big - 1)) &&
+                !feron::mm::paging::lookup(block, 1)) {
+                return feron::mm::paging::map_range(block, block_pa, big, r.flags);
+            }
+            return feron::mm::paging::map_page(page, r.phys + (page - r.base), r.flags);
+        }
+
+        uint64_t pa = feron::mm::zeropool::alloc_zeroed_page();
+        if (!pa) return false;
+        if (r.backing == BACK_FILL && !r.fill(r.ctx, page, feron::mm::phys_to_virt(pa))) {
+            feron::mm::pfa::free_page(pa);
+            return false;
+        }
+        if (!feron::mm::paging::map_page(page, pa, r.flags)) {
+            feron::mm::pfa::free_page(pa);
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include "../sync/spinlock.hpp"
+#include "hhdm.hpp"
+#include "pfa.hpp"
+
+// Pool of frames that are already zero. The idle loop fills it with non-temporal
+// stores, so a page table or zeroed buffer costs a pop instead of a 4 KiB clear
+// and does not evict the working set on the way.
+namespace feron::mm::zeropool {
+    constexpr uint32_t POOL_SIZE     = 64;   // frames kept ready
+    constexpr uint32_t REFILL_BUDGET = 8;    // frames zeroed per idle pass, so an interrupt is never held off long
+
+    inline uint64_t frames[POOL_SIZE];
+    inline uint32_t count = 0;
+    inline feron::sync::spinlock_t lock;
+
+    // Frames are zeroed through the direct map; until paging::init extends it past the
+    // trampoline's 4 GiB, the pool sticks to the low zones
+    inline uint32_t pool_zones = feron::mm::pfa::ZM_LOW;
+
+    // Clear a page with movnti (SSE2, always present on x86-64): bypasses the cache,
+    // which suits pages nobody is going to read soon
+    inline void zero_page_nt(void* page) {
+        auto* p = static_cast<uint64_t*>(page);
+        for (std::size_t i = 0; i < feron::mm::pfa::PAGE_SIZE / sizeof(uint64_t); i += 8) {
+            asm volatile(
+                "movnti %1, 0(%0)\n\t"  "movnti %1, 8(%0)\n\t"
+                "movnti %1, 16(%0)\n\t" "movnti %1, 24(%0)\n\t"
+                "movnti %1, 32(%0)\n\t" "movnti %1, 40(%0)\n\t"
+                "movnti %1, 48(%0)\n\t" "movnti %1, 56(%0)"
+                : : "r"(p + i), "r"(0ull) : "memory");
+        }
+        // order the weakly-ordered stores before the frame is published
+        asm volatile("sfence" : : : "memory");
+    }
+
+    // Clear a page through the cache, for a caller about to use it
+    inline void zero_page(void* page) {
+        void* d = page;
+        std::size_t n = feron::mm::pfa::PAGE_SIZE / sizeof(uint64_t);
+        asm volatile("rep stosq" : "+D"(d), "+c"(n) : "a"(0ull) : "memory");
+    }
+
+    // Top the pool up by at most REFILL_BUDGET frames; called from the idle loop
+    inline void refill() {
+        for (uint32_t n = 0; n < REFILL_BUDGET; ++n) {
+            {
+                feron::sync::irq_lock_guard g(lock);
+                if (count >= POOL_SIZE) return;
+            }
+
+            uint64_t pa = feron::mm::pfa::alloc_page(pool_zones);
+            if (!pa) return;
+            zero_page_nt(feron::mm::phys_to_virt(pa));
+
+            feron::sync::irq_lock_guard g(lock);
+            if (count < POOL_SIZE) { frames[count++] = pa; continue; }
+            feron::mm::pfa::free_page(pa); // someone else filled it meanwhile
+            return;
+        }
+    }
+
+    // A zero-filled frame, from the pool when possible (returns physical address or 0)
+    inline uint64_t alloc_zeroed_page() {
+        {
+            feron::sync::irq_lock_guard g(lock);
+            if (count) return frames[--count];
+        }
+        uint64_t pa = feron::mm::pfa::alloc_page(pool_zones);
+        if (pa) zero_page(feron::mm::phys_to_virt(pa));
+        return pa;
+    }
+}
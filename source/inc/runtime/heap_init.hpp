@@ -1,32 +1,116 @@
 #pragma once
 
-#include "../boot/mb2.hpp"
+#include "impl/mm/kernel_heap_backend.hpp"
 #include "impl/mm/kernel_heap_init.hpp"
-#include "../tty/tty.hpp"
+#include "../mm/config.hpp"
+#include "../mm/hhdm.hpp"
+#include "../mm/memblock.hpp"
+#include "../mm/page.hpp"
+#include "../mm/paging.hpp"
+#include "../mm/pfa.hpp"
+#include "../mm/valloc.hpp"
+#include "../mm/vmalloc.hpp"
 #include <cstdint>
 
 namespace feron::runtime {
 
-    inline void init_heap_from_mmap(const feron::boot::mb2::info_t& info) {
-        if (info.mmap && info.mmap_count > 0) {
-            for (uint32_t i = 0; i < info.mmap_count; ++i) {
-                auto& e = info.mmap[i];
-                if (e.type == 1 && e.len > 0) {
-                    // Clamp to first 4 MiB identity window
-                    uintptr_t start = static_cast<uintptr_t>(e.addr + 0x1000);
-                    uintptr_t end   = static_cast<uintptr_t>(e.addr + e.len);
-                    if (start >= 0x00400000) continue; // skip regions starting above 4 MiB
-                    if (end   >  0x00400000) end = 0x00400000;
-
-                    std::size_t heap_size = (end > start) ? static_cast<std::size_t>(end - start) : 0;
-                    if (heap_size < 64) continue;
-                    if (heap_size > 0x100000) heap_size = 0x100000; // keep bootstrap heap small (e.g., 1 MiB)
-
-                    void* heap_addr = reinterpret_cast<void*>(start);
-                    kernel_heap_init(heap_addr, heap_size);
-                    return;
-                }
-            }
+    // Carve the bootstrap heap out of usable RAM through memblock, so it never competes
+    // with the frame allocator's metadata and never overlaps the kernel image or modules.
+    inline void init_heap_from_memblock() {
+        uint64_t size = feron::mm::config::boot_heap_size;
+        uint64_t pa = feron::mm::memblock::alloc(size, feron::mm::memblock::PAGE, feron::mm::config::boot_map_limit);
+        if (!pa) return;
+
+        // reachable through the trampoline's direct map
+        kernel_heap_init(feron::mm::phys_to_virt(pa), static_cast<std::size_t>(size));
+    }
+
+    // Slab pages come from pfa through the direct map: one frame, or a buddy block for
+    // larger slabs; heap chunks and huge blocks are single frames mapped into the dynamic
+    // VA window. Every frame is tagged PG_SLAB with the block's base as its owner, so
+    // free() finds the owning layer with one descriptor lookup.
+    inline unsigned heap_pages_order(std::size_t pages) {
+        unsigned order = 0;
+        while ((1ull << order) < pages) ++order;
+        return order;
+    }
+
+    inline void* heap_page_alloc(std::size_t pages) {
+        unsigned order = heap_pages_order(pages);
+        uint64_t pa = order ? feron::mm::pfa::alloc_pages(order) : feron::mm::pfa::alloc_page();
+        if (!pa) return nullptr;
+        void* base = feron::mm::phys_to_virt(pa);
+        for (uint64_t i = 0; i < (1ull << order); ++i) {
+            feron::mm::page_t* pg = feron::mm::pfa::page_of(pa + i * feron::mm::pfa::PAGE_SIZE);
+            pg->flags |= feron::mm::PG_SLAB;
+            pg->owner = reinterpret_cast<uint64_t>(base);
         }
+        return base;
+    }
+
+    inline void heap_page_free(void* base, std::size_t pages) {
+        unsigned order = heap_pages_order(pages);
+        uint64_t pa = feron::mm::direct_to_phys(base);
+        for (uint64_t i = 0; i < (1ull << order); ++i) {
+            feron::mm::page_t* pg = feron::mm::pfa::page_of(pa + i * feron::mm::pfa::PAGE_SIZE);
+            pg->flags &= static_cast<uint16_t>(~feron::mm::PG_SLAB);
+            pg->owner = 0;
+        }
+        if (order) feron::mm::pfa::free_pages(pa, order);
+        else feron::mm::pfa::free_page(pa);
+    }
+
+    inline void* heap_page_owner(const void* p) {
+        uint64_t va = reinterpret_cast<uint64_t>(p);
+        uint64_t pa = feron::mm::in_direct_map(va) ? feron::mm::direct_to_phys(p) : feron::mm::paging::virt_to_phys(va);
+        feron::mm::page_t* pg = pa ? feron::mm::pfa::page_of(pa) : nullptr;
+        return (pg && (pg->flags & feron::mm::PG_SLAB)) ? reinterpret_cast<void*>(pg->owner) : nullptr;
+    }
+
+    inline void* heap_map(std::size_t pages, bool zeroed) {
+        const uint64_t page = feron::mm::pfa::PAGE_SIZE;
+        uint64_t va = feron::mm::valloc::alloc_range(pages * page);
+        if (!va) return nullptr;
+        uint64_t flags = feron::mm::paging::P_PRESENT | feron::mm::paging::P_RW | feron::mm::paging::P_NX;
+        uint64_t mapped = zeroed ? feron::mm::vmalloc::populate_zeroed(va, pages, flags)
+                                 : feron::mm::vmalloc::populate(va, pages, flags);
+        if (mapped < pages) {
+            feron::mm::vmalloc::release(va, mapped);
+            feron::mm::valloc::free_range(va, pages * page);
+            return nullptr;
+        }
+        for (uint64_t i = 0; i < pages; ++i) {
+            feron::mm::page_t* pg = feron::mm::pfa::page_of(feron::mm::paging::virt_to_phys(va + i * page));
+            pg->flags |= feron::mm::PG_SLAB;
+            pg->owner = va;
+        }
+        return reinterpret_cast<void*>(va);
+    }
+
+    inline void* heap_map_alloc(std::size_t pages) { return heap_map(pages, false); }
+
+    // Frames from the zeroed-page pool, for calloc
+    inline void* heap_map_alloc_zeroed(std::size_t pages) { return heap_map(pages, true); }
+
+    inline void heap_map_free(void* base, std::size_t pages) {
+        // freeing the frames clears their tags
+        uint64_t va = reinterpret_cast<uint64_t>(base);
+        feron::mm::vmalloc::release(va, pages);
+        feron::mm::valloc::free_range(va, pages * feron::mm::pfa::PAGE_SIZE);
+    }
+
+    inline kernel_heap_backend_t heap_backend;
+
+    // Hand the heap its page source; needs pfa and the full direct map
+    inline void init_heap_backend() {
+        heap_backend = {
+            heap_page_alloc, heap_page_free,
+            heap_map_alloc, heap_map_alloc_zeroed, heap_map_free,
+            heap_page_owner,
+            static_cast<std::size_t>(feron::mm::config::heap_chunk_size),
+            static_cast<std::size_t>(feron::mm::config::heap_huge_threshold),
+            static_cast<std::size_t>(feron::mm::config::heap_free_high_water),
+        };
+        kernel_heap_set_backend(&heap_backend);
     }
 }
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+extern "C" {
+    // Page source for the heap, provided by mm once paging is up. Every page handed out
+    // is tagged with the base of its block, which page_owner reports back.
+    struct kernel_heap_backend_t {
+        // physically contiguous pages (slabs); nullptr when out of memory
+        void* (*page_alloc)(std::size_t pages);
+        void  (*page_free)(void* base, std::size_t pages);
+        // virtually contiguous pages in the kernel's dynamic window (heap chunks, huge blocks);
+        // map_free also takes the tail of a mapping, which is how huge blocks shrink
+        void* (*map_alloc)(std::size_t pages);
+        void* (*map_alloc_zeroed)(std::size_t pages);   // as map_alloc, reading as zero
+        void  (*map_free)(void* base, std::size_t pages);
+        // base of the block containing p, or nullptr if p is not backend memory
+        void* (*page_owner)(const void* p);
+
+        std::size_t chunk_size;        // the heap grows by at least this much
+        std::size_t huge_threshold;    // requests this large get a mapping of their own
+        std::size_t free_high_water;   // free chunks are returned while free bytes stay above this
+    };
+
+    void kernel_heap_set_backend(const kernel_heap_backend_t* backend);
+}
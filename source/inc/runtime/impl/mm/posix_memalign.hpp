@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstddef>
+
+extern "C" {
+    int posix_memalign(void** memptr, std::size_t alignment, std::size_t size);
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+
+namespace feron::sync {
+    // Test-and-test-and-set spinlock
+    struct spinlock_t {
+        volatile uint8_t locked = 0;
+    };
+
+    inline void lock(spinlock_t& l) {
+        while (__atomic_test_and_set(&l.locked, __ATOMIC_ACQUIRE)) {
+            while (__atomic_load_n(&l.locked, __ATOMIC_RELAXED)) asm volatile("pause");
+        }
+    }
+
+    inline void unlock(spinlock_t& l) {
+        __atomic_clear(&l.locked, __ATOMIC_RELEASE);
+    }
+
+    // Fair spinlock: CPUs are served in ticket order, so none can starve under contention.
+    // Waiters back off exponentially between polls, keeping the cache line quiet.
+    struct ticket_lock_t {
+        volatile uint16_t next = 0;     // ticket handed to the next arrival
+        volatile uint16_t owner = 0;    // ticket now being served
+    };
+
+    constexpr uint32_t TICKET_BACKOFF_MAX = 256;   // pause iterations between polls
+
+    inline void lock(ticket_lock_t& l) {
+        uint16_t me = __atomic_fetch_add(&l.next, 1, __ATOMIC_RELAXED);
+        uint32_t backoff = 1;
+        while (__atomic_load_n(&l.owner, __ATOMIC_ACQUIRE) != me) {
+            for (uint32_t i = 0; i < backoff; ++i) asm volatile("pause");
+            if (backoff < TICKET_BACKOFF_MAX) backoff <<= 1;
+        }
+    }
+
+    inline void unlock(ticket_lock_t& l) {
+        // only the holder writes owner
+        __atomic_store_n(&l.owner, static_cast<uint16_t>(l.owner + 1), __ATOMIC_RELEASE);
+    }
+
+    // Save RFLAGS and mask interrupts on this CPU
+    inline uint64_t irq_save() {
+        uint64_t flags;
+        asm volatile("pushfq\n\tpopq %0\n\tcli" : "=r"(flags) : : "memory");
+        return flags;
+    }
+
+    // Re-enable interrupts only if they were enabled when irq_save ran
+    inline void irq_restore(uint64_t flags) {
+        if (flags & (1ull << 9)) asm volatile("sti" : : : "memory");
+    }
+
+    // Holds a spinlock (or ticket lock) with interrupts masked, so a handler on this CPU
+    // can never spin on it
+    template <typename Lock>
+    struct irq_lock_guard {
+        Lock& l;
+        uint64_t flags;
+
+        explicit irq_lock_guard(Lock& lk) : l(lk), flags(irq_save()) { lock(l); }
+        ~irq_lock_guard() { unlock(l); irq_restore(flags); }
+
+        irq_lock_guard(const irq_lock_guard&) = delete;
+        irq_lock_guard& operator=(const irq_lock_guard&) = delete;
+    };
+}
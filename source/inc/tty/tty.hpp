@@ -7,7 +7,8 @@
 namespace feron::tty {
     constexpr int WIDTH  = 80;
     constexpr int HEIGHT = 25;
-    inline volatile uint16_t* VGA = reinterpret_cast<volatile uint16_t*>(0xB8000);
+    // Text buffer at 0xB8000, through the direct map (mm::config::hhdm_base); nothing is identity mapped after boot
+    inline volatile uint16_t* VGA = reinterpret_cast<volatile uint16_t*>(0xFFFF8000000B8000ull);
 
     enum Color : uint8_t {
         BLACK = 0, BLUE = 1, GREEN = 2, CYAN = 3, RED = 4, MAGENTA = 5,